@@ -3,16 +3,30 @@
 // We make a population of tours (i.e., itineraries that start and end at one city and visit every city on the map).
 // We evolve the population of tours, hoping that we eventually evolve one that's short enough.
 
-#include <cmath> // sqrt
-#include <cstdlib> // rand, srand
+#include <cmath> // acos, ceil, cos, fabs, floor, sqrt
+#include <cstdint> // uint32_t, uint64_t
+#include <cstdlib> // abort
 #include <ctime> // time
 
 #include <iostream> // We use standard console input and output.
 #include <string> // We use getline(istream &, string &).
 
-#include <algorithm> // find, max_element, random_shuffle
+#include <algorithm> // copy, equal, find, max_element, min, min_element, partial_sort, pop_heap, push_heap, sort, sort_heap, stable_sort, unique
 #include <vector> // We use vectors extensively.
 
+#include <atomic> // We hand out work to threads through an atomic counter.
+#include <condition_variable> // The threads of a pool wait for work.
+#include <functional> // hash
+#include <memory> // make_shared, shared_ptr, unique_ptr
+#include <mutex> // Each thread of a pool protects its queue of tasks.
+#include <thread> // We build some large tables, and evolve populations, in parallel.
+#include <unordered_set> // A map checks for duplicate cities with a hash set.
+#include <utility> // make_pair, pair, swap
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h> // We compute the lengths of itineraries with AVX2 or AVX-512, if the processor has them.
+#endif
+
 #include "bitmap_image.hpp" // We use this excellent, open source bitmap library.
 // It is obtained from https://github.com/ArashPartow/bitmap
 // It is provided under the following agreement: https://opensource.org/licenses/cpl1.0.php
@@ -27,29 +41,347 @@ char getOneChar(istream &is = cin)
  return str[0];
 }
 
-// Return a random integer in [a, b).
-unsigned int randomIndex(const unsigned int &a, const unsigned int &b)
-{
- return (rand() % (b - a)) + a;
-}
+// This is our source of random numbers: the counter-based generator Philox4x32-10 of Salmon, Moraes, Dror, and Shaw ("Parallel random numbers: as easy as 1, 2, 3").
+// The n-th block of random bits is a pure function of a key (the seed), a stream number, and n, so we never have to pass a generator's state from one thread to another.
+// Instead, each independent piece of work (e.g., making one child) gets its own stream, numbered by what the work is, not by which thread does it.
+// Hence, a given seed produces exactly the same results however many threads share the work.
+class Random {
+ private:
+  uint32_t key[2];
+  uint32_t counter[4]; // Words 0 and 1 count the blocks drawn from this stream; words 2 and 3 are the stream number.
+  uint32_t block[4]; // This is the current block of random bits...
+  unsigned int used; // ... of which this many words have been used.
+
+  // Scramble x; this is the finalizer of SplitMix64.
+  static uint64_t mix(uint64_t x)
+  {
+   x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+   x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+   return x ^ (x >> 31);
+  }
+
+  // Compute the block for the current counter, and advance the counter.
+  void refill()
+  {
+   uint32_t k[2] = { key[0], key[1] };
+   uint32_t c[4] = { counter[0], counter[1], counter[2], counter[3] };
+
+   for (unsigned int round = 0; round < 10; round ++)
+   {
+    uint64_t p0 = static_cast<uint64_t>(0xd2511f53) * c[0];
+    uint64_t p1 = static_cast<uint64_t>(0xcd9e8d57) * c[2];
+    uint32_t d[4] = { static_cast<uint32_t>(p1 >> 32) ^ c[1] ^ k[0], static_cast<uint32_t>(p1), static_cast<uint32_t>(p0 >> 32) ^ c[3] ^ k[1], static_cast<uint32_t>(p0) };
+    copy(d, d + 4, c);
+    k[0] += 0x9e3779b9;
+    k[1] += 0xbb67ae85;
+   }
+
+   copy(c, c + 4, block);
+   used = 0;
+
+   if (++ counter[0] == 0)
+   {
+    counter[1] ++;
+   }
+
+   return;
+  }
+ public:
+
+  // This generator can be used wherever the standard library expects a uniform random bit generator.
+  typedef uint32_t result_type;
+
+  // Create the generator for the indicated seed and stream.
+  explicit Random(const uint64_t &seed, const uint64_t &stream = 0) : used(4)
+  {
+   key[0] = static_cast<uint32_t>(seed);
+   key[1] = static_cast<uint32_t>(seed >> 32);
+   counter[0] = counter[1] = 0;
+   counter[2] = static_cast<uint32_t>(stream);
+   counter[3] = static_cast<uint32_t>(stream >> 32);
+  }
+
+  // Return the generator, with the same seed, of the substream numbered id of this stream.
+  // Substreams depend only on the seed, this stream's number, and id, not on how many numbers have been drawn.
+  Random stream(const uint64_t &id) const
+  {
+   uint64_t number = (static_cast<uint64_t>(counter[3]) << 32) | counter[2];
+   return Random((static_cast<uint64_t>(key[1]) << 32) | key[0], mix(mix(number) + id));
+  }
+
+  static constexpr result_type min()
+  {
+   return 0;
+  }
+
+  static constexpr result_type max()
+  {
+   return 0xffffffff;
+  }
+
+  // Return 32 random bits.
+  result_type operator ()()
+  {
+   if (used == 4)
+   {
+    refill();
+   }
+   return block[used ++];
+  }
+
+  // Return a random integer in [a, b), without the bias of taking a remainder (this is Lemire's method).
+  unsigned int index(const unsigned int &a, const unsigned int &b)
+  {
+   uint32_t range = b - a;
+   uint64_t m = static_cast<uint64_t>((*this)()) * range;
+   if (static_cast<uint32_t>(m) < range)
+   {
+    uint32_t threshold = -range % range;
+    while (static_cast<uint32_t>(m) < threshold)
+    {
+     m = static_cast<uint64_t>((*this)()) * range;
+    }
+   }
+   return a + static_cast<uint32_t>(m >> 32);
+  }
+
+  // Return a random double in [a, b).
+  double real(const double &a = 0, const double &b = 1)
+  {
+   uint64_t bits = (static_cast<uint64_t>((*this)()) << 32) | (*this)();
+   return (bits >> 11) * (1.0 / 9007199254740992.0) * (b - a) + a; // Use 53 random bits, as many as a double holds.
+  }
+};
 
-// Return a random double in [a, b].
-double randomDouble(const double &a = 0, const double &b = 1)
+// Call f(k) for every k in [begin, end), sharing the work among all of the hardware threads.
+// The range is handed out in chunks of the indicated size through an atomic counter, so threads that finish early simply take more chunks.
+// (This matters when the cost of f(k) depends on k, e.g., when filling the rows of a triangular table.)
+// Different calls f(k) must not write to the same memory.
+template <class Function>
+void parallelFor(const unsigned int &begin, const unsigned int &end, Function f, const unsigned int &chunk = 16)
 {
- return (static_cast<double>(rand()) / RAND_MAX) * (b - a) + a;
+ if (begin >= end)
+ {
+  return;
+ }
+
+ atomic<unsigned int> next(begin); // This is the first index that no thread has claimed yet.
+
+ // Each thread claims chunks of indices until none are left.
+ auto work = [&]()
+ {
+  unsigned int first;
+  while ((first = next.fetch_add(chunk)) < end)
+  {
+   unsigned int last = min(end, first + chunk);
+   for (unsigned int k = first; k < last; k ++)
+   {
+    f(k);
+   }
+  }
+ };
+
+ unsigned int n_threads = max(1u, thread::hardware_concurrency());
+ n_threads = min(n_threads, (end - begin + chunk - 1) / chunk); // There is no point in starting threads that will find nothing to do.
+
+ vector<thread> threads;
+ for (unsigned int t = 1; t < n_threads; t ++)
+ {
+  threads.push_back(thread(work));
+ }
+ work(); // The calling thread does its share, too.
+ for (unsigned int t = 0; t < threads.size(); t ++)
+ {
+  threads[t].join();
+ }
+
+ return;
 }
 
-// A city is just a an ordered pair of integers in [0, width)x[0, height), where width and height are positive integers.
+// A thread pool runs batches of numbered tasks on a fixed set of threads, one of which is the thread that submits the batch.
+// The tasks of a batch are first divided evenly among the threads' queues.
+// A thread that runs out of tasks steals half of the remaining tasks of another thread, so the load stays balanced even when some tasks take much longer than others.
+// Apart from stealing, a thread only ever touches its own queue, so the threads rarely wait for each other.
+class ThreadPool {
+ private:
+  // The queue of a thread is a range of task numbers: its owner takes tasks from the front, and thieves take them from the back.
+  struct Queue {
+   mutex lock;
+   unsigned int front;
+   unsigned int back;
+  };
+
+  unsigned int n_threads;
+  unique_ptr<Queue[]> queues; // Thread w owns queues[w].
+  vector<thread> workers; // Thread w, for w > 0, is workers[w - 1]; thread 0 is whichever thread calls run.
+
+  mutex lock; // This protects everything below.
+  condition_variable wake; // The workers wait on this for a new batch.
+  condition_variable done; // The submitting thread waits on this for the workers to finish the batch.
+  unsigned int batch; // This counts the batches submitted so far.
+  unsigned int n_busy; // This is the number of workers still working on the current batch.
+  bool stopping;
+
+  // The current batch calls task(context, k, w) for each task k, where w is the thread running the task.
+  void (*task)(void *, unsigned int, unsigned int);
+  void *context;
+
+  template <class Function>
+  static void callFunction(void *function, unsigned int k, unsigned int w)
+  {
+   (*static_cast<Function *>(function))(k, w);
+  }
+
+  // Take a task from the front of the queue of thread w, and return whether there was one.
+  bool takeTask(const unsigned int &w, unsigned int &k)
+  {
+   lock_guard<mutex> guard(queues[w].lock);
+   if (queues[w].front == queues[w].back)
+   {
+    return false;
+   }
+   k = queues[w].front ++;
+   return true;
+  }
+
+  // Move half of the tasks of some other thread to the (empty) queue of thread w, and return whether there were any.
+  // We never hold two locks at once, so thieves cannot deadlock each other.
+  bool stealTasks(const unsigned int &w)
+  {
+   for (unsigned int i = 1; i < n_threads; i ++)
+   {
+    Queue &victim = queues[(w + i) % n_threads];
+    unsigned int front, back;
+    {
+     lock_guard<mutex> guard(victim.lock);
+     if (victim.front == victim.back)
+     {
+      continue;
+     }
+     back = victim.back;
+     front = victim.back -= (victim.back - victim.front + 1) / 2;
+    }
+    lock_guard<mutex> guard(queues[w].lock);
+    queues[w].front = front;
+    queues[w].back = back;
+    return true;
+   }
+   return false;
+  }
+
+  // Run tasks as thread w until there are none left anywhere.
+  void work(const unsigned int &w)
+  {
+   unsigned int k;
+   do {
+    while (takeTask(w, k))
+    {
+     task(context, k, w);
+    }
+   } while (stealTasks(w));
+  }
+
+  // This is what each worker does until the pool is destroyed.
+  void workerLoop(const unsigned int w)
+  {
+   unsigned int seen = 0; // This is the last batch that this worker worked on.
+   unique_lock<mutex> guard(lock);
+   while (true)
+   {
+    wake.wait(guard, [&]() { return stopping || batch != seen; });
+    if (stopping)
+    {
+     return;
+    }
+    seen = batch;
+
+    guard.unlock();
+    work(w);
+    guard.lock();
+
+    if (-- n_busy == 0)
+    {
+     done.notify_one();
+    }
+   }
+  }
+ public:
+
+  // Create a pool of n threads, counting the thread that will submit batches.
+  // If n is 0, use one thread per core.
+  explicit ThreadPool(const unsigned int &n = 0) : n_threads(n > 0 ? n : max(1u, thread::hardware_concurrency())), queues(new Queue[n_threads]), batch(0), n_busy(0), stopping(false), task(0), context(0)
+  {
+   for (unsigned int w = 1; w < n_threads; w ++)
+   {
+    workers.push_back(thread(&ThreadPool::workerLoop, this, w));
+   }
+  }
+
+  ~ThreadPool()
+  {
+   {
+    lock_guard<mutex> guard(lock);
+    stopping = true;
+   }
+   wake.notify_all();
+   for (unsigned int w = 0; w < workers.size(); w ++)
+   {
+    workers[w].join();
+   }
+  }
+
+  unsigned int size() const
+  {
+   return n_threads;
+  }
+
+  // Call f(k, w) for every task k in [0, n_tasks), where w in [0, size()) identifies the thread making the call.
+  // Two calls with the same w never run at the same time, so f can use per-thread scratch space indexed by w.
+  // Return once every task is done.
+  template <class Function>
+  void run(const unsigned int &n_tasks, Function &f)
+  {
+   for (unsigned int w = 0; w < n_threads; w ++)
+   {
+    queues[w].front = static_cast<unsigned long long>(n_tasks) * w / n_threads;
+    queues[w].back = static_cast<unsigned long long>(n_tasks) * (w + 1) / n_threads;
+   }
+   task = &callFunction<Function>;
+   context = &f;
+
+   // Wake the workers, and do our share of the work.
+   {
+    lock_guard<mutex> guard(lock);
+    batch ++;
+    n_busy = n_threads - 1;
+   }
+   wake.notify_all();
+   work(0);
+
+   // Wait for the workers to finish their tasks.
+   unique_lock<mutex> guard(lock);
+   done.wait(guard, [&]() { return n_busy == 0; });
+  }
+};
+
+// A city is just an ordered pair of integers.
+// Random cities lie in [0, width)x[0, height), where width and height are positive integers, but the cities given to a map may lie anywhere.
+// The coordinates are signed 64-bit integers, so that differences never wrap, and so that coordinates such as latitudes and longitudes can be negative.
 class City {
  public:
-  unsigned int x;
-  unsigned int y;
+  long long x;
+  long long y;
+
+  // Construct the city at (x, y).
+  City(const long long &x, const long long &y) : x(x), y(y)
+  {
+  }
 
   // Construct a random city, i.e., a city whose coordinates are randomly chosen in [0, width)x[0, height).
-  City(const unsigned int &width, const unsigned int &height)
+  City(const unsigned int &width, const unsigned int &height, Random &random)
   {
-   x = rand() % width;
-   y = rand() % height;
+   x = random.index(0, width);
+   y = random.index(0, height);
   }
 };
 
@@ -59,329 +391,4610 @@ bool operator ==(const City &a, const City &b)
  return a.x == b.x && a.y == b.y;
 }
 
-// Return the Euclidean distance between a and b as a double.
-double distanceBetweenCities(const City &a, const City &b)
-{
- return sqrt((a.x - b.x) * (a.x - b.x) + (a.y - b.y) * (a.y - b.y));
-}
+// We hash cities in order to keep them in an unordered_set.
+// Both coordinates are hashed in full, so that cities with negative or large coordinates do not collide.
+struct CityHash {
+ size_t operator ()(const City &city) const
+ {
+  return (hash<long long>()(city.x) * 1000003) ^ hash<long long>()(city.y);
+ }
+};
+
+// Return the Euclidean distance between a and b as a double.
+// We subtract the coordinates as doubles, which is exact, and which the length kernels (below) can do, too.
+double distanceBetweenCities(const City &a, const City &b)
+{
+ double dx = static_cast<double>(a.x) - b.x, dy = static_cast<double>(a.y) - b.y;
+ return sqrt(dx * dx + dy * dy);
+}
+
+// A metric tells a map how to measure the distance between two cities.
+// Maps, and everything that works with a map, take the metric as a template parameter, so the distance is inlined wherever it is used; there is no virtual call, even in the innermost loops.
+// A metric is a class with a static member function distance(a, b), and a static constant euclidean, which says whether the distance is exactly distanceBetweenCities, so that the vector length kernels (below) can compute it.
+// Apart from EuclideanMetric, the metrics are those of TSPLIB, and they give the same (whole) distances as TSPLIB does, so that tour lengths can be compared with published optima.
+
+// The exact Euclidean distance.
+struct EuclideanMetric {
+ static const bool euclidean = true;
+
+ static double distance(const City &a, const City &b)
+ {
+  return distanceBetweenCities(a, b);
+ }
+};
+
+// The Euclidean distance rounded to the nearest integer (EUC_2D in TSPLIB).
+struct RoundedEuclideanMetric {
+ static const bool euclidean = false;
+
+ static double distance(const City &a, const City &b)
+ {
+  return floor(distanceBetweenCities(a, b) + 0.5);
+ }
+};
+
+// The Euclidean distance rounded up to the next integer (CEIL_2D in TSPLIB).
+struct CeilingEuclideanMetric {
+ static const bool euclidean = false;
+
+ static double distance(const City &a, const City &b)
+ {
+  return ceil(distanceBetweenCities(a, b));
+ }
+};
+
+// The Manhattan distance (MAN_2D in TSPLIB), i.e., the sum of the differences of the coordinates.
+// The coordinates are integers, so there is nothing to round.
+struct ManhattanMetric {
+ static const bool euclidean = false;
+
+ static double distance(const City &a, const City &b)
+ {
+  return fabs(static_cast<double>(a.x) - b.x) + fabs(static_cast<double>(a.y) - b.y);
+ }
+};
+
+// The maximum distance (MAX_2D in TSPLIB), i.e., the larger of the differences of the coordinates.
+struct MaximumMetric {
+ static const bool euclidean = false;
+
+ static double distance(const City &a, const City &b)
+ {
+  return max(fabs(static_cast<double>(a.x) - b.x), fabs(static_cast<double>(a.y) - b.y));
+ }
+};
+
+// The pseudo-Euclidean distance (ATT in TSPLIB), used by the att48 and att532 instances.
+struct PseudoEuclideanMetric {
+ static const bool euclidean = false;
+
+ static double distance(const City &a, const City &b)
+ {
+  double dx = static_cast<double>(a.x) - b.x, dy = static_cast<double>(a.y) - b.y;
+  double r = sqrt((dx * dx + dy * dy) / 10);
+  double t = floor(r + 0.5);
+  return t < r ? t + 1 : t;
+ }
+};
+
+// The geographical distance (GEO in TSPLIB), in kilometers, on the idealized sphere of TSPLIB.
+// The coordinates are integers, so x is the latitude and y the longitude written as DDDMM (degrees times 100, plus minutes), negative in the south and in the west; TSPLIB writes the same as DDD.MM.
+struct GeographicMetric {
+ static const bool euclidean = false;
+
+ // Convert DDDMM to radians, truncating the degrees as TSPLIB does.
+ static double radians(const long long &coordinate)
+ {
+  const double pi = 3.141592; // TSPLIB uses this value of pi, so we do, too.
+  long long degrees = coordinate / 100;
+  return pi * (degrees + (coordinate - 100 * degrees) / 60.0) / 180;
+ }
+
+ static double distance(const City &a, const City &b)
+ {
+  const double radius = 6378.388;
+  double q1 = cos(radians(a.y) - radians(b.y));
+  double q2 = cos(radians(a.x) - radians(b.x));
+  double q3 = cos(radians(a.x) + radians(b.x));
+  return floor(radius * acos(min(1.0, 0.5 * ((1 + q1) * q2 - (1 - q1) * q3))) + 1); // Rounding may push the cosine just above 1 for very close cities.
+ }
+};
+
+// A candidate graph lists, for each city, a few other cities that a good tour is likely to visit right before or after it.
+// Local search and crossover can restrict themselves to these candidates, rather than considering every city.
+// The lists are stored one after another in a single array (i.e., in compressed sparse row form).
+class CandidateGraph {
+ private:
+  vector<unsigned int> offsets; // The candidates of city i are cities[offsets[i]], ..., cities[offsets[i + 1] - 1].
+  vector<unsigned int> cities;
+ public:
+
+  CandidateGraph() : offsets(1, 0)
+  {
+  }
+
+  // Create the graph in which city i has the candidates lists[i].
+  explicit CandidateGraph(const vector<vector<unsigned int> > &lists) : offsets(1, 0)
+  {
+   for (unsigned int i = 0; i < lists.size(); i ++)
+   {
+    cities.insert(cities.end(), lists[i].begin(), lists[i].end());
+    offsets.push_back(cities.size());
+   }
+  }
+
+  // Create the graph in which each of n cities has k candidates, stored in the order of the cities: the candidates of city i are list[i * k], ..., list[(i + 1) * k - 1].
+  CandidateGraph(const unsigned int &n, const unsigned int &k, const vector<unsigned int> &list) : offsets(n + 1), cities(list)
+  {
+   for (unsigned int i = 0; i <= n; i ++)
+   {
+    offsets[i] = i * k;
+   }
+  }
+
+  // Return the number of cities.
+  unsigned int size() const
+  {
+   return offsets.size() - 1;
+  }
+
+  // Return the number of candidates of city i.
+  unsigned int degree(const unsigned int &i) const
+  {
+   return offsets[i + 1] - offsets[i];
+  }
+
+  // The candidates of city i are those in [begin(i), end(i)).
+  const unsigned int *begin(const unsigned int &i) const
+  {
+   return cities.data() + offsets[i];
+  }
+
+  const unsigned int *end(const unsigned int &i) const
+  {
+   return cities.data() + offsets[i + 1];
+  }
+
+  // Return the total number of candidates, i.e., the number of directed edges.
+  unsigned int nEdges() const
+  {
+   return cities.size();
+  }
+};
+
+// A grid index cuts the bounding box of the cities into equal cells, with about two cities per cell, and records which cities lie in each cell.
+// Cells are counted from the corner of the box with the smallest coordinates, so the coordinates may be negative.
+// Then the cities near a point can be found by looking at the cells near the point, rather than at every city.
+class GridIndex {
+ private:
+  const vector<City> *cities;
+  unsigned int columns;
+  unsigned int rows;
+  long long min_x; // This is the corner of the bounding box with the smallest coordinates.
+  long long min_y;
+  double cell_width;
+  double cell_height;
+  vector<unsigned int> cell_start; // The cities in cell c are sorted[cell_start[c]], ..., sorted[cell_start[c + 1] - 1].
+  vector<unsigned int> sorted;
+
+  unsigned int columnOf(const City &city) const
+  {
+   return min(columns - 1, static_cast<unsigned int>((city.x - min_x) / cell_width));
+  }
+
+  unsigned int rowOf(const City &city) const
+  {
+   return min(rows - 1, static_cast<unsigned int>((city.y - min_y) / cell_height));
+  }
+ public:
+
+  GridIndex() : cities(0), columns(0), rows(0), min_x(0), min_y(0), cell_width(0), cell_height(0)
+  {
+  }
+
+  // Index the cities c.
+  // The index refers to c, which must outlive it.
+  // Sorting the cities into cells is a counting sort, which takes linear time.
+  GridIndex(const vector<City> &c) : cities(&c), min_x(0), min_y(0)
+  {
+   const unsigned int n = c.size();
+   unsigned int i;
+
+   // Find the bounding box of the cities.
+   long long max_x = 0, max_y = 0;
+   if (n > 0)
+   {
+    min_x = max_x = c[0].x;
+    min_y = max_y = c[0].y;
+   }
+   for (i = 1; i < n; i ++)
+   {
+    min_x = min(min_x, c[i].x);
+    max_x = max(max_x, c[i].x);
+    min_y = min(min_y, c[i].y);
+    max_y = max(max_y, c[i].y);
+   }
+   const double width = static_cast<double>(max_x - min_x) + 1, height = static_cast<double>(max_y - min_y) + 1;
+
+   // Choose the number of columns and rows so that the cells are roughly square, with about two cities each.
+   double cells = max(1.0, n / 2.0);
+   columns = max(1u, static_cast<unsigned int>(min(cells, sqrt(cells * width / height)))); // A long, thin box still gets no more cells than that.
+   rows = max(1u, static_cast<unsigned int>(cells / columns));
+   cell_width = width / columns;
+   cell_height = height / rows;
+
+   // Count the cities in each cell, and then place each city after those of the cells before it.
+   cell_start.assign(columns * rows + 1, 0);
+   for (i = 0; i < n; i ++)
+   {
+    cell_start[rowOf(c[i]) * columns + columnOf(c[i]) + 1] ++;
+   }
+   for (i = 0; i < columns * rows; i ++)
+   {
+    cell_start[i + 1] += cell_start[i];
+   }
+   sorted.resize(n);
+   vector<unsigned int> next(cell_start.begin(), cell_start.end() - 1);
+   for (i = 0; i < n; i ++)
+   {
+    sorted[next[rowOf(c[i]) * columns + columnOf(c[i])] ++] = i;
+   }
+  }
+
+  // Put the k cities nearest to city i (not counting city i itself), nearest first, in nearest.
+  // Ties are broken by index, so the result does not depend on the layout of the grid.
+  // We look at the cells in rings of growing size around the cell of city i, and stop once no city in a further ring could be nearer than the k-th nearest city found so far.
+  void nearest(const unsigned int &i, const unsigned int &k, vector<unsigned int> &nearest) const
+  {
+   const City &city = (*cities)[i];
+   const int column = columnOf(city), row = rowOf(city);
+   const double cell_size = min(cell_width, cell_height);
+   const unsigned int n_wanted = min<unsigned int>(k, cities->size() - 1);
+
+   vector<pair<long long, unsigned int> > heap; // The nearest cities found so far, as (squared distance, index), with the farthest on top.
+
+   for (int ring = 0; ; ring ++)
+   {
+    // Stop if the ring lies entirely outside of the grid.
+    if (column - ring < 0 && row - ring < 0 && column + ring >= static_cast<int>(columns) && row + ring >= static_cast<int>(rows))
+    {
+     break;
+    }
+
+    // Visit the cells on the boundary of the square of cells at distance ring from the city's cell.
+    for (int r = row - ring; r <= row + ring; r ++)
+    {
+     if (r < 0 || r >= static_cast<int>(rows))
+     {
+      continue;
+     }
+     bool edge = r == row - ring || r == row + ring; // In the top and bottom rows of the square, we visit every cell; otherwise, only the first and last.
+     for (int c = column - ring; c <= column + ring; c += (edge || ring == 0) ? 1 : 2 * ring)
+     {
+      if (c < 0 || c >= static_cast<int>(columns))
+      {
+       continue;
+      }
+      unsigned int cell = r * columns + c;
+      for (unsigned int s = cell_start[cell]; s < cell_start[cell + 1]; s ++)
+      {
+       unsigned int j = sorted[s];
+       if (j == i)
+       {
+        continue;
+       }
+       long long dx = static_cast<long long>((*cities)[j].x) - city.x;
+       long long dy = static_cast<long long>((*cities)[j].y) - city.y;
+       pair<long long, unsigned int> candidate(dx * dx + dy * dy, j);
+       if (heap.size() < n_wanted)
+       {
+        heap.push_back(candidate);
+        push_heap(heap.begin(), heap.end());
+       }
+       else if (n_wanted > 0 && candidate < heap.front())
+       {
+        pop_heap(heap.begin(), heap.end());
+        heap.back() = candidate;
+        push_heap(heap.begin(), heap.end());
+       }
+      }
+     }
+    }
+
+    // Every city beyond this ring is at least ring * cell_size away.
+    if (heap.size() == n_wanted && (n_wanted == 0 || heap.front().first < (ring * cell_size) * (ring * cell_size)))
+    {
+     break;
+    }
+   }
+
+   sort_heap(heap.begin(), heap.end());
+   nearest.resize(heap.size());
+   for (unsigned int j = 0; j < heap.size(); j ++)
+   {
+    nearest[j] = heap[j].second;
+   }
+
+   return;
+  }
+};
+
+// A Delaunay triangulation of a set of cities connects two cities whenever some circle passes through both of them and has no city inside it.
+// Its edges are excellent candidates: they include the nearest neighbor of every city, and they adapt to clusters, where a fixed number of nearest neighbors would all lie in the same cluster.
+// On average, each city has fewer than six neighbors in the triangulation.
+// We compute it with the divide-and-conquer algorithm of Guibas and Stolfi ("Primitives for the manipulation of general subdivisions and the computation of Voronoi diagrams"), which takes O(N log N) time.
+// The geometric tests are exact (they use 128-bit integer arithmetic), so this works even for the many collinear and cocircular cities of an integer lattice, provided the coordinates are less than 2^30.
+class DelaunayTriangulation {
+ private:
+  const vector<City> &cities;
+  vector<unsigned int> order; // The indices of the cities, sorted by x and then by y.
+
+  // The triangulation is stored as a quad-edge structure: edge e, its dual edges, and its reverse form a group of four, e & ~3, ..., (e & ~3) + 3.
+  vector<unsigned int> next; // next[e] is the next edge counterclockwise around the origin of e.
+  vector<unsigned int> origin; // origin[e] is the city at which e starts (for the primal edges, whose numbers are even).
+  vector<bool> deleted; // deleted[e / 4] records whether the group of e has been deleted.
+
+  static unsigned int rot(const unsigned int &e)
+  {
+   return (e & ~3u) | ((e + 1) & 3u);
+  }
+
+  static unsigned int sym(const unsigned int &e)
+  {
+   return (e & ~3u) | ((e + 2) & 3u);
+  }
+
+  static unsigned int rotInverse(const unsigned int &e)
+  {
+   return (e & ~3u) | ((e + 3) & 3u);
+  }
+
+  unsigned int onext(const unsigned int &e) const
+  {
+   return next[e];
+  }
+
+  unsigned int oprev(const unsigned int &e) const
+  {
+   return rot(next[rot(e)]);
+  }
+
+  unsigned int lnext(const unsigned int &e) const
+  {
+   return rot(next[rotInverse(e)]);
+  }
+
+  unsigned int rprev(const unsigned int &e) const
+  {
+   return next[sym(e)];
+  }
+
+  unsigned int org(const unsigned int &e) const
+  {
+   return origin[e];
+  }
+
+  unsigned int dest(const unsigned int &e) const
+  {
+   return origin[sym(e)];
+  }
+
+  // Make an edge from city a to city b, by itself.
+  unsigned int makeEdge(const unsigned int &a, const unsigned int &b)
+  {
+   unsigned int e = next.size();
+   next.push_back(e);
+   next.push_back(e + 3);
+   next.push_back(e + 2);
+   next.push_back(e + 1);
+   origin.push_back(a);
+   origin.push_back(0);
+   origin.push_back(b);
+   origin.push_back(0);
+   deleted.push_back(false);
+   return e;
+  }
+
+  // Join or separate the rings of edges around the origins of a and b.
+  void splice(const unsigned int &a, const unsigned int &b)
+  {
+   unsigned int alpha = rot(next[a]);
+   unsigned int beta = rot(next[b]);
+   ::swap(next[a], next[b]);
+   ::swap(next[alpha], next[beta]);
+  }
+
+  // Add an edge from the destination of a to the origin of b, so that a, the new edge, and b share a left face.
+  unsigned int connect(const unsigned int &a, const unsigned int &b)
+  {
+   unsigned int e = makeEdge(dest(a), org(b));
+   splice(e, lnext(a));
+   splice(sym(e), b);
+   return e;
+  }
+
+  void deleteEdge(const unsigned int &e)
+  {
+   splice(e, oprev(e));
+   splice(sym(e), oprev(sym(e)));
+   deleted[e / 4] = true;
+  }
+
+  // Return whether the cities a, b, and c make a counterclockwise turn.
+  bool ccw(const unsigned int &a, const unsigned int &b, const unsigned int &c) const
+  {
+   long long bx = static_cast<long long>(cities[b].x) - cities[a].x, by = static_cast<long long>(cities[b].y) - cities[a].y;
+   long long cx = static_cast<long long>(cities[c].x) - cities[a].x, cy = static_cast<long long>(cities[c].y) - cities[a].y;
+   return bx * cy - by * cx > 0;
+  }
+
+  bool rightOf(const unsigned int &c, const unsigned int &e) const
+  {
+   return ccw(c, dest(e), org(e));
+  }
+
+  bool leftOf(const unsigned int &c, const unsigned int &e) const
+  {
+   return ccw(c, org(e), dest(e));
+  }
+
+  // Return whether city d lies strictly inside the circle through the cities a, b, and c (in counterclockwise order).
+  bool inCircle(const unsigned int &a, const unsigned int &b, const unsigned int &c, const unsigned int &d) const
+  {
+   __int128 ax = static_cast<long long>(cities[a].x) - cities[d].x, ay = static_cast<long long>(cities[a].y) - cities[d].y;
+   __int128 bx = static_cast<long long>(cities[b].x) - cities[d].x, by = static_cast<long long>(cities[b].y) - cities[d].y;
+   __int128 cx = static_cast<long long>(cities[c].x) - cities[d].x, cy = static_cast<long long>(cities[c].y) - cities[d].y;
+   __int128 a2 = ax * ax + ay * ay, b2 = bx * bx + by * by, c2 = cx * cx + cy * cy;
+   return ax * (by * c2 - b2 * cy) - ay * (bx * c2 - b2 * cx) + a2 * (bx * cy - by * cx) > 0;
+  }
+
+  // Return whether the edge e lies above the base edge, i.e., whether it can be the next edge of the merge.
+  bool valid(const unsigned int &e, const unsigned int &base) const
+  {
+   return rightOf(dest(e), base);
+  }
+
+  // Triangulate the cities order[lo], ..., order[hi - 1], where hi - lo >= 2.
+  // Return the counterclockwise convex hull edge out of the leftmost city, and the clockwise convex hull edge out of the rightmost city.
+  pair<unsigned int, unsigned int> triangulate(const unsigned int &lo, const unsigned int &hi)
+  {
+   if (hi - lo == 2)
+   {
+    unsigned int a = makeEdge(order[lo], order[lo + 1]);
+    return make_pair(a, sym(a));
+   }
+
+   if (hi - lo == 3)
+   {
+    unsigned int s1 = order[lo], s2 = order[lo + 1], s3 = order[lo + 2];
+    unsigned int a = makeEdge(s1, s2);
+    unsigned int b = makeEdge(s2, s3);
+    splice(sym(a), b);
+    if (ccw(s1, s2, s3)) // Close the triangle.
+    {
+     connect(b, a);
+     return make_pair(a, sym(b));
+    }
+    if (ccw(s1, s3, s2)) // Close the triangle the other way around.
+    {
+     unsigned int c = connect(b, a);
+     return make_pair(sym(c), c);
+    }
+    return make_pair(a, sym(b)); // The three cities are collinear.
+   }
+
+   unsigned int mid = lo + (hi - lo) / 2;
+   pair<unsigned int, unsigned int> left = triangulate(lo, mid);
+   pair<unsigned int, unsigned int> right = triangulate(mid, hi);
+   unsigned int ldo = left.first, ldi = left.second;
+   unsigned int rdi = right.first, rdo = right.second;
+
+   // Find the lower common tangent of the two halves.
+   while (true)
+   {
+    if (leftOf(org(rdi), ldi))
+    {
+     ldi = lnext(ldi);
+    }
+    else if (rightOf(org(ldi), rdi))
+    {
+     rdi = rprev(rdi);
+    }
+    else
+    {
+     break;
+    }
+   }
+
+   unsigned int base = connect(sym(rdi), ldi);
+   if (org(ldi) == org(ldo))
+   {
+    ldo = sym(base);
+   }
+   if (org(rdi) == org(rdo))
+   {
+    rdo = base;
+   }
+
+   // Zip the halves together, from the bottom up, deleting the edges of each half that fail the empty circle test.
+   while (true)
+   {
+    unsigned int lcand = onext(sym(base));
+    if (valid(lcand, base))
+    {
+     while (inCircle(dest(base), org(base), dest(lcand), dest(onext(lcand))))
+     {
+      unsigned int t = onext(lcand);
+      deleteEdge(lcand);
+      lcand = t;
+     }
+    }
+
+    unsigned int rcand = oprev(base);
+    if (valid(rcand, base))
+    {
+     while (inCircle(dest(base), org(base), dest(rcand), dest(oprev(rcand))))
+     {
+      unsigned int t = oprev(rcand);
+      deleteEdge(rcand);
+      rcand = t;
+     }
+    }
+
+    bool l = valid(lcand, base), r = valid(rcand, base);
+    if (!l && !r) // The base edge is the upper common tangent, so we're done.
+    {
+     break;
+    }
+    if (!l || (r && inCircle(dest(lcand), org(lcand), org(rcand), dest(rcand))))
+    {
+     base = connect(rcand, sym(base));
+    }
+    else
+    {
+     base = connect(sym(base), sym(lcand));
+    }
+   }
+
+   return make_pair(ldo, rdo);
+  }
+ public:
+
+  // Triangulate the cities c, which must be distinct.
+  explicit DelaunayTriangulation(const vector<City> &c) : cities(c), order(c.size())
+  {
+   for (unsigned int i = 0; i < order.size(); i ++)
+   {
+    order[i] = i;
+   }
+   sort(order.begin(), order.end(), [&](const unsigned int &a, const unsigned int &b) { return cities[a].x != cities[b].x ? cities[a].x < cities[b].x : cities[a].y < cities[b].y; });
+
+   // A triangulation has fewer than 3N edges.
+   next.reserve(12 * order.size());
+   origin.reserve(12 * order.size());
+
+   if (order.size() >= 2)
+   {
+    triangulate(0, order.size());
+   }
+  }
+
+  // Return, for each city, the cities to which it is connected, nearest first.
+  vector<vector<unsigned int> > neighbors() const
+  {
+   vector<vector<unsigned int> > lists(cities.size());
+   for (unsigned int q = 0; q < deleted.size(); q ++)
+   {
+    if (!deleted[q])
+    {
+     lists[origin[4 * q]].push_back(origin[4 * q + 2]);
+     lists[origin[4 * q + 2]].push_back(origin[4 * q]);
+    }
+   }
+   for (unsigned int i = 0; i < lists.size(); i ++)
+   {
+    sort(lists[i].begin(), lists[i].end(), [&](const unsigned int &a, const unsigned int &b)
+    {
+     long long ax = static_cast<long long>(cities[a].x) - cities[i].x, ay = static_cast<long long>(cities[a].y) - cities[i].y;
+     long long bx = static_cast<long long>(cities[b].x) - cities[i].x, by = static_cast<long long>(cities[b].y) - cities[i].y;
+     long long da = ax * ax + ay * ay, db = bx * bx + by * by;
+     return da != db ? da < db : a < b;
+    });
+   }
+   return lists;
+  }
+};
+
+// The candidate graphs that a map provides.
+enum CandidateSet {
+ NEAREST_CANDIDATES, // The nearest neighbors of each city.
+ DELAUNAY_CANDIDATES, // The neighbors of each city in the Delaunay triangulation.
+ DELAUNAY_AND_NEAREST_CANDIDATES // Both of the above.
+};
+
+// A map remembers the distance between every pair of its cities, so that we never compute a square root twice.
+// The table can hold all N*N entries, or only the N*(N-1)/2 entries above the diagonal (the distance is symmetric, and it vanishes on the diagonal).
+// Past some tens of thousands of cities, neither fits in memory, so the map can instead remember only the distances from each city to its nearest neighbors, and compute the others.
+enum DistanceStorage {
+ FULL_MATRIX, // Looking up an entry is a single multiplication and addition.
+ TRIANGULAR_MATRIX, // This needs half of the memory, but looking up an entry costs a little more.
+ NEIGHBOR_CACHE // This needs one cache line per city (see NeighborLine).
+};
+
+// The entries of the distance table can be doubles or floats.
+// Floats halve the memory again, at the price of about seven significant digits per distance.
+// They can also be whole numbers (the distances multiplied by the map's scale and rounded, as TSPLIB does), stored as 32-bit integers.
+// Then every length is a whole number, and a sum of whole numbers does not depend on the order of its terms, so lengths updated move by move never drift, and comparing them is exact.
+// (Lengths are still doubles, which hold every whole number up to 2^53 exactly.)
+enum DistancePrecision {
+ DOUBLE_PRECISION,
+ SINGLE_PRECISION,
+ INTEGER_PRECISION
+};
+
+// The length of a whole itinerary can be computed from the coordinates of its cities, without the distance table.
+// The coordinates are kept as doubles in two separate arrays (one for x, one for y), so that a vector instruction can gather the coordinates of several cities at once; we compute several edges at a time with AVX-512 (or, for many itineraries at once, AVX2) where the processor has it (chosen at run time), and one at a time otherwise.
+// Every kernel adds edge e to the partial sum e % 8, and adds up the partial sums in the same order, so they all give exactly the same length.
+// Each edge is computed exactly as distanceBetweenCities computes it (and rounded to a float if the distance table holds floats), so the lengths agree with the table.
+// The cities of the itinerary are numbered by Index (see BasicTour), so there is a kernel of each kind for each type of number.
+template <class Index>
+using LengthKernel = double (*)(const double *xs, const double *ys, const Index *cities, const unsigned int &n, const bool &single);
+
+// Add up the partial sums of the kernels.
+inline double sumPartials(const double *partials)
+{
+ return ((partials[0] + partials[1]) + (partials[2] + partials[3])) + ((partials[4] + partials[5]) + (partials[6] + partials[7]));
+}
+
+// Add the edges e in [begin, n) of the itinerary to the partial sums, one at a time.
+template <class Index>
+inline void addEdges(const double *xs, const double *ys, const Index *cities, const unsigned int &n, const bool &single, const unsigned int &begin, double *partials)
+{
+ for (unsigned int e = begin; e < n; e ++)
+ {
+  unsigned int a = cities[e], b = cities[e + 1 < n ? e + 1 : 0];
+  double dx = xs[a] - xs[b], dy = ys[a] - ys[b];
+  double d = sqrt(dx * dx + dy * dy);
+  partials[e % 8] += single ? static_cast<float>(d) : d;
+ }
+}
+
+template <class Index>
+double lengthScalar(const double *xs, const double *ys, const Index *cities, const unsigned int &n, const bool &single)
+{
+ double partials[8] = { 0, 0, 0, 0, 0, 0, 0, 0 };
+ addEdges(xs, ys, cities, n, single, 0, partials);
+ return sumPartials(partials);
+}
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+
+// GCC 12 wrongly warns that the gathers read an uninitialized register.
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+
+// The edges e, ..., e + 7 go from cities[e], ..., cities[e + 7] to cities[e + 1], ..., cities[e + 8], so the vector loops stop while e + 8 < n, and the remaining edges (including the one that closes the itinerary) are added one at a time.
+// We prefetch the coordinates of the cities a few steps ahead, since the gathers would otherwise wait on cache misses all the time.
+static const unsigned int prefetch_distance = 32;
+
+// The gathers take 32-bit indices, so the kernels widen 16-bit city numbers as they load them.
+__attribute__((target("avx2")))
+inline __m256i loadEightCities(const unsigned int *cities)
+{
+ return _mm256_loadu_si256(reinterpret_cast<const __m256i *>(cities));
+}
+
+__attribute__((target("avx2")))
+inline __m256i loadEightCities(const uint16_t *cities)
+{
+ return _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(cities)));
+}
+
+template <class Index>
+__attribute__((target("avx512f")))
+double lengthAVX512(const double *xs, const double *ys, const Index *cities, const unsigned int &n, const bool &single)
+{
+ __m512d sum = _mm512_setzero_pd();
+ unsigned int e = 0;
+
+ for (; e + 8 < n; e += 8)
+ {
+  for (unsigned int k = e + prefetch_distance; k < e + prefetch_distance + 8 && k < n; k ++) // Prefetch all eight cities that the gathers will need, not just the first.
+  {
+   _mm_prefetch(reinterpret_cast<const char *>(xs + cities[k]), _MM_HINT_T0);
+   _mm_prefetch(reinterpret_cast<const char *>(ys + cities[k]), _MM_HINT_T0);
+  }
+  __m256i a = loadEightCities(cities + e);
+  __m256i b = loadEightCities(cities + e + 1);
+  __m512d dx = _mm512_sub_pd(_mm512_i32gather_pd(a, xs, 8), _mm512_i32gather_pd(b, xs, 8));
+  __m512d dy = _mm512_sub_pd(_mm512_i32gather_pd(a, ys, 8), _mm512_i32gather_pd(b, ys, 8));
+  __m512d d = _mm512_sqrt_pd(_mm512_add_pd(_mm512_mul_pd(dx, dx), _mm512_mul_pd(dy, dy)));
+  if (single)
+  {
+   d = _mm512_cvtps_pd(_mm512_cvtpd_ps(d));
+  }
+  sum = _mm512_add_pd(sum, d);
+ }
+
+ double partials[8];
+ _mm512_storeu_pd(partials, sum);
+ addEdges(xs, ys, cities, n, single, e, partials);
+ return sumPartials(partials);
+}
+
+// Choose the AVX-512 kernel if this processor supports it, and the scalar kernel otherwise.
+// Within one itinerary, four-wide AVX2 gathers turned out to be slower than the scalar kernel (e.g., 2.7 against 2.0 microseconds for a good tour of 1000 cities), so there is no AVX2 kernel for single itineraries; the batch kernels below, whose lanes follow different itineraries, do gain from AVX2.
+template <class Index>
+LengthKernel<Index> chooseLengthKernel()
+{
+ __builtin_cpu_init();
+ if (__builtin_cpu_supports("avx512f"))
+ {
+  return lengthAVX512<Index>;
+ }
+ return lengthScalar<Index>;
+}
+
+#pragma GCC diagnostic pop
+
+#else
+
+template <class Index>
+LengthKernel<Index> chooseLengthKernel()
+{
+ return lengthScalar<Index>;
+}
+
+#endif
+
+// Return the kernel to use, which is chosen once and for all.
+template <class Index>
+LengthKernel<Index> lengthKernel()
+{
+ static const LengthKernel<Index> kernel = chooseLengthKernel<Index>();
+ return kernel;
+}
+
+// A batch kernel computes the lengths of many itineraries of n cities each, stored one after another (e.g., the rows of a tour arena), and puts them in lengths.
+// The vector kernels give each lane its own itinerary, so that the gathers of different lanes, which miss the cache at different times, overlap; within a lane, edge e still goes to partial sum e % 8, so every length is exactly the same as a length kernel would give.
+template <class Index>
+using BatchLengthKernel = void (*)(const double *xs, const double *ys, const Index *cities, const unsigned int &n_itineraries, const unsigned int &n, const bool &single, double *lengths);
+
+template <class Index>
+void batchLengthsScalar(const double *xs, const double *ys, const Index *cities, const unsigned int &n_itineraries, const unsigned int &n, const bool &single, double *lengths)
+{
+ for (unsigned int t = 0; t < n_itineraries; t ++)
+ {
+  lengths[t] = lengthScalar(xs, ys, cities + static_cast<size_t>(t) * n, n, single);
+ }
+}
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+
+// GCC 12 wrongly warns that the gathers read an uninitialized register.
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+
+// Return city e of each lane's itinerary, where the lanes' itineraries start at base + rows.
+// 32-bit city numbers are gathered, but there is no gather of 16-bit numbers, so those are loaded one at a time.
+__attribute__((target("avx2")))
+inline __m128i laneCities(const unsigned int *base, const __m128i &rows, const unsigned int &, const unsigned int &e)
+{
+ return _mm_i32gather_epi32(reinterpret_cast<const int *>(base + e), rows, 4);
+}
+
+__attribute__((target("avx2")))
+inline __m128i laneCities(const uint16_t *base, const __m128i &, const unsigned int &n, const unsigned int &e)
+{
+ return _mm_setr_epi32(base[e], base[n + e], base[2 * n + e], base[3 * n + e]);
+}
+
+__attribute__((target("avx512f,avx2")))
+inline __m256i laneCities(const unsigned int *base, const __m256i &rows, const unsigned int &, const unsigned int &e)
+{
+ return _mm256_i32gather_epi32(reinterpret_cast<const int *>(base + e), rows, 4);
+}
+
+__attribute__((target("avx512f,avx2")))
+inline __m256i laneCities(const uint16_t *base, const __m256i &, const unsigned int &n, const unsigned int &e)
+{
+ return _mm256_setr_epi32(base[e], base[n + e], base[2 * n + e], base[3 * n + e], base[4 * n + e], base[5 * n + e], base[6 * n + e], base[7 * n + e]);
+}
+
+// Add edge e of each lane's itinerary, which starts at (x, y), to sum, and move (x, y) to the end of the edge.
+template <class Index>
+__attribute__((target("avx2")))
+inline void batchEdgeAVX2(const double *xs, const double *ys, const Index *base, const __m128i &rows, const unsigned int &n, const unsigned int &e, const bool &single, __m256d &x, __m256d &y, __m256d &sum)
+{
+ __m128i b = laneCities(base, rows, n, e + 1 < n ? e + 1 : 0);
+ __m256d next_x = _mm256_i32gather_pd(xs, b, 8), next_y = _mm256_i32gather_pd(ys, b, 8);
+ __m256d dx = _mm256_sub_pd(x, next_x), dy = _mm256_sub_pd(y, next_y);
+ __m256d d = _mm256_sqrt_pd(_mm256_add_pd(_mm256_mul_pd(dx, dx), _mm256_mul_pd(dy, dy)));
+ if (single)
+ {
+  d = _mm256_cvtps_pd(_mm256_cvtpd_ps(d));
+ }
+ sum = _mm256_add_pd(sum, d);
+ x = next_x;
+ y = next_y;
+}
+
+template <class Index>
+__attribute__((target("avx2")))
+void batchLengthsAVX2(const double *xs, const double *ys, const Index *cities, const unsigned int &n_itineraries, const unsigned int &n, const bool &single, double *lengths)
+{
+ const __m128i rows = _mm_setr_epi32(0, n, 2 * n, 3 * n); // These are the offsets of the lanes' itineraries.
+ unsigned int t = 0;
+
+ for (; t + 4 <= n_itineraries; t += 4)
+ {
+  const Index *base = cities + static_cast<size_t>(t) * n;
+  __m256d sums[8];
+  for (unsigned int k = 0; k < 8; k ++)
+  {
+   sums[k] = _mm256_setzero_pd();
+  }
+
+  // Walk the four itineraries together, carrying the coordinates of each edge's end over to the start of the next edge.
+  __m128i a = laneCities(base, rows, n, 0);
+  __m256d x = _mm256_i32gather_pd(xs, a, 8), y = _mm256_i32gather_pd(ys, a, 8);
+  unsigned int e = 0;
+  for (; e + 8 <= n; e += 8) // Unrolling by eight keeps the partial sums in registers.
+  {
+   for (unsigned int k = 0; k < 8; k ++)
+   {
+    batchEdgeAVX2(xs, ys, base, rows, n, e + k, single, x, y, sums[k]);
+   }
+  }
+  for (; e < n; e ++)
+  {
+   batchEdgeAVX2(xs, ys, base, rows, n, e, single, x, y, sums[e % 8]);
+  }
+
+  double partials[8][4];
+  for (unsigned int k = 0; k < 8; k ++)
+  {
+   _mm256_storeu_pd(partials[k], sums[k]);
+  }
+  for (unsigned int j = 0; j < 4; j ++)
+  {
+   double lane[8] = { partials[0][j], partials[1][j], partials[2][j], partials[3][j], partials[4][j], partials[5][j], partials[6][j], partials[7][j] };
+   lengths[t + j] = sumPartials(lane);
+  }
+ }
+
+ batchLengthsScalar(xs, ys, cities + static_cast<size_t>(t) * n, n_itineraries - t, n, single, lengths + t);
+}
+
+template <class Index>
+__attribute__((target("avx512f,avx2")))
+inline void batchEdgeAVX512(const double *xs, const double *ys, const Index *base, const __m256i &rows, const unsigned int &n, const unsigned int &e, const bool &single, __m512d &x, __m512d &y, __m512d &sum)
+{
+ __m256i b = laneCities(base, rows, n, e + 1 < n ? e + 1 : 0);
+ __m512d next_x = _mm512_i32gather_pd(b, xs, 8), next_y = _mm512_i32gather_pd(b, ys, 8);
+ __m512d dx = _mm512_sub_pd(x, next_x), dy = _mm512_sub_pd(y, next_y);
+ __m512d d = _mm512_sqrt_pd(_mm512_add_pd(_mm512_mul_pd(dx, dx), _mm512_mul_pd(dy, dy)));
+ if (single)
+ {
+  d = _mm512_cvtps_pd(_mm512_cvtpd_ps(d));
+ }
+ sum = _mm512_add_pd(sum, d);
+ x = next_x;
+ y = next_y;
+}
+
+template <class Index>
+__attribute__((target("avx512f,avx2")))
+void batchLengthsAVX512(const double *xs, const double *ys, const Index *cities, const unsigned int &n_itineraries, const unsigned int &n, const bool &single, double *lengths)
+{
+ const __m256i rows = _mm256_setr_epi32(0, n, 2 * n, 3 * n, 4 * n, 5 * n, 6 * n, 7 * n);
+ unsigned int t = 0;
+
+ for (; t + 8 <= n_itineraries; t += 8)
+ {
+  const Index *base = cities + static_cast<size_t>(t) * n;
+  __m512d sums[8];
+  for (unsigned int k = 0; k < 8; k ++)
+  {
+   sums[k] = _mm512_setzero_pd();
+  }
+
+  __m256i a = laneCities(base, rows, n, 0);
+  __m512d x = _mm512_i32gather_pd(a, xs, 8), y = _mm512_i32gather_pd(a, ys, 8);
+  unsigned int e = 0;
+  for (; e + 8 <= n; e += 8) // Unrolling by eight keeps the partial sums in registers.
+  {
+   for (unsigned int k = 0; k < 8; k ++)
+   {
+    batchEdgeAVX512(xs, ys, base, rows, n, e + k, single, x, y, sums[k]);
+   }
+  }
+  for (; e < n; e ++)
+  {
+   batchEdgeAVX512(xs, ys, base, rows, n, e, single, x, y, sums[e % 8]);
+  }
+
+  double partials[8][8];
+  for (unsigned int k = 0; k < 8; k ++)
+  {
+   _mm512_storeu_pd(partials[k], sums[k]);
+  }
+  for (unsigned int j = 0; j < 8; j ++)
+  {
+   double lane[8] = { partials[0][j], partials[1][j], partials[2][j], partials[3][j], partials[4][j], partials[5][j], partials[6][j], partials[7][j] };
+   lengths[t + j] = sumPartials(lane);
+  }
+ }
+
+ batchLengthsScalar(xs, ys, cities + static_cast<size_t>(t) * n, n_itineraries - t, n, single, lengths + t);
+}
+
+template <class Index>
+BatchLengthKernel<Index> chooseBatchLengthKernel()
+{
+ __builtin_cpu_init();
+ if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx2"))
+ {
+  return batchLengthsAVX512<Index>;
+ }
+ if (__builtin_cpu_supports("avx2"))
+ {
+  return batchLengthsAVX2<Index>;
+ }
+ return batchLengthsScalar<Index>;
+}
+
+#pragma GCC diagnostic pop
+
+#else
+
+template <class Index>
+BatchLengthKernel<Index> chooseBatchLengthKernel()
+{
+ return batchLengthsScalar<Index>;
+}
+
+#endif
+
+template <class Index>
+BatchLengthKernel<Index> batchLengthKernel()
+{
+ static const BatchLengthKernel<Index> kernel = chooseBatchLengthKernel<Index>();
+ return kernel;
+}
+
+// Metrics other than the Euclidean one have no vector kernels, so we compute their lengths one edge at a time, from the cities themselves.
+// Edge e still goes to partial sum e % 8, so the lengths agree with the table in the same way.
+template <class Metric, class Index>
+double lengthWithMetric(const City *points, const Index *cities, const unsigned int &n, const bool &single)
+{
+ double partials[8] = {0, 0, 0, 0, 0, 0, 0, 0};
+ for (unsigned int e = 0; e < n; e ++)
+ {
+  double d = Metric::distance(points[cities[e]], points[cities[e + 1 < n ? e + 1 : 0]]);
+  partials[e % 8] += single ? static_cast<float>(d) : d;
+ }
+ return sumPartials(partials);
+}
+
+// In a NEIGHBOR_CACHE, each city has a line of 64 bytes, i.e., one cache line, which holds the distances from the city to its (up to) five nearest neighbors.
+// Nearly every edge of a good tour joins a city to one of its five nearest neighbors, and looking such a distance up reads just the one line.
+// The lines are written once, when the map is created, so threads can read them without any locking.
+struct NeighborLine {
+ static const unsigned int capacity = 5;
+ uint32_t cities[capacity];
+ uint32_t count;
+ double distances[capacity];
+};
+
+static_assert(sizeof(NeighborLine) == 64, "A neighbor line should fill exactly one cache line.");
+
+// The order in which a map numbers its cities.
+// The numbers index every array about the cities (their coordinates, the distance table, the neighbor lists, ...), so when cities that are near each other on the map have numbers near each other, the cities along a good tour are near each other in memory, too, and far fewer accesses miss the cache.
+enum CityOrder {
+ GENERATION_ORDER, // The cities are numbered in the order in which they were made.
+ HILBERT_ORDER, // The cities are numbered along a Hilbert curve, which never jumps, so it keeps neighbors closest together.
+ MORTON_ORDER // The cities are numbered along a Z-order curve, which is cheaper to compute, but which jumps now and then.
+};
+
+// Return the position of (x, y) along the Hilbert curve through the square [0, 2^bits)x[0, 2^bits), where bits is at most 32.
+unsigned long long hilbertKey(unsigned long long x, unsigned long long y, const unsigned int &bits)
+{
+ const unsigned long long last = (1ULL << bits) - 1;
+ unsigned long long key = 0;
+
+ for (unsigned long long s = 1ULL << (bits - 1); s > 0; s >>= 1)
+ {
+  unsigned long long rx = (x & s) != 0, ry = (y & s) != 0;
+  key += s * s * ((3 * rx) ^ ry);
+
+  // Turn the quadrant around, so that the curve through it is in the standard position.
+  if (ry == 0)
+  {
+   if (rx == 1)
+   {
+    x = last - x;
+    y = last - y;
+   }
+   swap(x, y);
+  }
+ }
+
+ return key;
+}
+
+// Return the position of (x, y) along the Z-order curve through the square [0, 2^bits)x[0, 2^bits), where bits is at most 32, i.e., interleave the bits of x and y.
+unsigned long long mortonKey(const unsigned long long &x, const unsigned long long &y, const unsigned int &bits)
+{
+ unsigned long long key = 0;
+ for (unsigned int b = 0; b < bits; b ++)
+ {
+  key |= ((x >> b) & 1) << (2 * b) | ((y >> b) & 1) << (2 * b + 1);
+ }
+ return key;
+}
+
+// For the most part, a map is just a list of cities that should be visited along a tour.
+// To this end, the class Map is derived from the class vector.
+// For convenience, we also record a _width and _height: those of the rectangle [0, _width)x[0, _height) from which random cities were drawn, or else those of the bounding box of the given cities.
+// We also record the table of distances between cities, since looking up a distance is much cheaper than computing it.
+// The distances are measured by Metric; a Map measures them with the exact Euclidean distance.
+template <class Metric>
+class BasicMap : public vector<City> {
+ private:
+  unsigned int _width;
+  unsigned int _height;
+
+  DistanceStorage _storage;
+  DistancePrecision _precision;
+  double _scale; // If _precision is INTEGER_PRECISION, the table holds the distances multiplied by _scale and rounded.
+  vector<double> _distances; // This is the distance table if _precision is DOUBLE_PRECISION.
+  vector<float> _distances_float; // This is the distance table if _precision is SINGLE_PRECISION.
+  vector<int32_t> _distances_integer; // This is the distance table if _precision is INTEGER_PRECISION.
+  vector<size_t> _row_offsets; // If _storage is TRIANGULAR_MATRIX, the entry for i < j is at _row_offsets[i] + j.
+  vector<char> _lines; // If _storage is NEIGHBOR_CACHE, this holds a NeighborLine for each city, starting at the first multiple of 64 bytes (see line).
+
+#ifdef GA_CACHE_STATISTICS
+  mutable atomic<unsigned long long> _hits; // These count the lookups in the neighbor cache that found the distance...
+  mutable atomic<unsigned long long> _misses; // ... and those that had to compute it.
+#endif
+
+  vector<unsigned int> _original; // The city at index i was the city _original[i] before the cities were renumbered.
+
+  vector<double> _xs; // These are the coordinates of the cities, for the length kernels.
+  vector<double> _ys;
+
+  GridIndex index; // This tells us which cities are near a given city.
+  CandidateGraph _nearest; // This lists the nearest neighbors of each city.
+  CandidateGraph _delaunay; // This lists the neighbors of each city in the Delaunay triangulation.
+  CandidateGraph _combined; // This lists both of the above, without repetition.
+
+  // Return the graph whose candidates for city i are those of a and those of b, without repetition and nearest first.
+  CandidateGraph unite(const CandidateGraph &a, const CandidateGraph &b) const
+  {
+   vector<vector<unsigned int> > lists(size());
+   for (unsigned int i = 0; i < size(); i ++)
+   {
+    lists[i].assign(a.begin(i), a.end(i));
+    lists[i].insert(lists[i].end(), b.begin(i), b.end(i));
+    sort(lists[i].begin(), lists[i].end(), [&](const unsigned int &x, const unsigned int &y)
+    {
+     double dx = distance(i, x), dy = distance(i, y);
+     return dx != dy ? dx < dy : x < y;
+    });
+    lists[i].erase(unique(lists[i].begin(), lists[i].end()), lists[i].end());
+   }
+   return CandidateGraph(lists);
+  }
+
+  // Return the position in the distance table of the entry for the cities at indices i and j.
+  // The indices must be distinct if _storage is TRIANGULAR_MATRIX.
+  size_t entry(const unsigned int &i, const unsigned int &j) const
+  {
+   if (_storage == FULL_MATRIX)
+   {
+    return static_cast<size_t>(i) * size() + j;
+   }
+   return i < j ? _row_offsets[i] + j : _row_offsets[j] + i;
+  }
+
+  // Return the distance between the cities at indices i and j, computed by Metric, and rounded as the distance table rounds it.
+  double measure(const unsigned int &i, const unsigned int &j) const
+  {
+   double d = Metric::distance((*this)[i], (*this)[j]);
+   if (_precision == SINGLE_PRECISION)
+   {
+    return static_cast<float>(d);
+   }
+   if (_precision == INTEGER_PRECISION)
+   {
+    return static_cast<int32_t>(floor(_scale * d + 0.5));
+   }
+   return d;
+  }
+
+  // Return the neighbor line of the city at index i.
+  // A vector only promises the alignment of a double, so we skip ahead to the first cache line boundary.
+  const NeighborLine &line(const unsigned int &i) const
+  {
+   uintptr_t first = (reinterpret_cast<uintptr_t>(_lines.data()) + 63) & ~static_cast<uintptr_t>(63);
+   return reinterpret_cast<const NeighborLine *>(first)[i];
+  }
+
+  NeighborLine &line(const unsigned int &i)
+  {
+   return const_cast<NeighborLine &>(static_cast<const BasicMap &>(*this).line(i));
+  }
+
+  // Return the distance between the distinct cities at indices i and j from the neighbor cache, or compute it if j is not one of the nearest neighbors of i.
+  double cachedDistance(const unsigned int &i, const unsigned int &j) const
+  {
+   const NeighborLine &l = line(i);
+   for (unsigned int k = 0; k < l.count; k ++)
+   {
+    if (l.cities[k] == j)
+    {
+#ifdef GA_CACHE_STATISTICS
+     _hits.fetch_add(1, memory_order_relaxed);
+#endif
+     return l.distances[k];
+    }
+   }
+#ifdef GA_CACHE_STATISTICS
+   _misses.fetch_add(1, memory_order_relaxed);
+#endif
+   return measure(i, j);
+  }
+
+  // Fill the neighbor cache from the lists of nearest neighbors, which must have been found already.
+  // The lines are empty until then, so any distance needed before (e.g., to sort the lists) is computed.
+  void buildNeighborCache()
+  {
+   parallelFor(0, size(), [&](const unsigned int &i)
+   {
+    NeighborLine &l = line(i);
+    l.count = 0;
+    for (const unsigned int *c = _nearest.begin(i); c != _nearest.end(i) && l.count < NeighborLine::capacity; c ++)
+    {
+     l.cities[l.count] = *c;
+     l.distances[l.count] = measure(i, *c);
+     l.count ++;
+    }
+   }, 256);
+
+   return;
+  }
+
+  // Number the cities in the given order.
+  // The square through which the curve runs is the smallest one (with a power of two for a side) that holds every city; coordinates that span more than 2^32 keep only their 32 highest bits, which is plenty to order the cities.
+  void renumber(const CityOrder &order)
+  {
+   const unsigned int n = size();
+   unsigned int i;
+
+   _original.resize(n);
+   for (i = 0; i < n; i ++)
+   {
+    _original[i] = i;
+   }
+   if (order == GENERATION_ORDER || n == 0)
+   {
+    return;
+   }
+
+   long long min_x = (*this)[0].x, min_y = (*this)[0].y;
+   unsigned long long extent = 0;
+   for (i = 0; i < n; i ++)
+   {
+    min_x = min(min_x, (*this)[i].x);
+    min_y = min(min_y, (*this)[i].y);
+   }
+   for (i = 0; i < n; i ++)
+   {
+    extent = max(extent, max(static_cast<unsigned long long>((*this)[i].x - min_x), static_cast<unsigned long long>((*this)[i].y - min_y)));
+   }
+   unsigned int bits = 1, shift = 0;
+   while (bits < 64 && extent >> bits != 0)
+   {
+    bits ++;
+   }
+   if (bits > 32)
+   {
+    shift = bits - 32;
+    bits = 32;
+   }
+
+   vector<pair<unsigned long long, unsigned int> > keys(n);
+   parallelFor(0, n, [&](const unsigned int &k)
+   {
+    unsigned long long x = static_cast<unsigned long long>((*this)[k].x - min_x) >> shift, y = static_cast<unsigned long long>((*this)[k].y - min_y) >> shift;
+    keys[k] = make_pair(order == HILBERT_ORDER ? hilbertKey(x, y, bits) : mortonKey(x, y, bits), k);
+   }, 1024);
+   sort(keys.begin(), keys.end()); // Cities with the same key stay in the order in which they were made.
+
+   vector<City> cities(begin(), end());
+   for (i = 0; i < n; i ++)
+   {
+    _original[i] = keys[i].second;
+    (*this)[i] = cities[keys[i].second];
+   }
+
+   return;
+  }
+
+  // Compute the distance table.
+  // The rows are independent of each other, so we fill them in parallel.
+  void buildDistanceTable()
+  {
+   const unsigned int n = size();
+   size_t n_entries;
+
+   if (_storage == NEIGHBOR_CACHE) // There is no table; we only make room for the lines, which are empty for now.
+   {
+    _lines.assign((static_cast<size_t>(n) + 1) * sizeof(NeighborLine), 0);
+    return;
+   }
+
+   if (_storage == FULL_MATRIX)
+   {
+    n_entries = static_cast<size_t>(n) * n;
+   }
+   else
+   {
+    // Row i holds the entries for j in (i, n), and we shift its offset so that it can be indexed directly by j.
+    _row_offsets.resize(n);
+    n_entries = 0;
+    for (unsigned int i = 0; i < n; i ++)
+    {
+     _row_offsets[i] = n_entries - (i + 1);
+     n_entries += n - (i + 1);
+    }
+   }
+
+   if (_precision == DOUBLE_PRECISION)
+   {
+    _distances.resize(n_entries);
+   }
+   else if (_precision == SINGLE_PRECISION)
+   {
+    _distances_float.resize(n_entries);
+   }
+   else
+   {
+    _distances_integer.resize(n_entries);
+   }
+
+   parallelFor(0, n, [&](const unsigned int &i)
+   {
+    // In a full matrix, we fill the whole row; otherwise, we only fill the part of the row above the diagonal.
+    for (unsigned int j = _storage == FULL_MATRIX ? 0 : i + 1; j < n; j ++)
+    {
+     double d = measure(i, j);
+     if (_precision == DOUBLE_PRECISION)
+     {
+      _distances[entry(i, j)] = d;
+     }
+     else if (_precision == SINGLE_PRECISION)
+     {
+      _distances_float[entry(i, j)] = static_cast<float>(d);
+     }
+     else
+     {
+      _distances_integer[entry(i, j)] = static_cast<int32_t>(d);
+     }
+    }
+   });
+
+   return;
+  }
+
+  // Compute the k nearest neighbors of every city.
+  // Each city's neighbors are found independently of the others, so we find them in parallel.
+  void buildNearestNeighbors(const unsigned int &k)
+  {
+   const unsigned int n = size();
+   const unsigned int degree = min(k, n - 1);
+   vector<unsigned int> list(static_cast<size_t>(n) * degree);
+
+   parallelFor(0, n, [&](const unsigned int &i)
+   {
+    vector<unsigned int> nearest;
+    index.nearest(i, degree, nearest);
+    if (!Metric::euclidean) // The grid finds the nearest cities in the Euclidean sense, which are close enough as candidates, but we list them nearest first according to Metric.
+    {
+     stable_sort(nearest.begin(), nearest.end(), [&](const unsigned int &x, const unsigned int &y) { return distance(i, x) < distance(i, y); });
+    }
+    copy(nearest.begin(), nearest.end(), list.begin() + static_cast<size_t>(i) * degree);
+   }, 64);
+
+   _nearest = CandidateGraph(n, degree, list);
+
+   return;
+  }
+
+  // Return n distinct, random cities in [0, w)x[0, h), drawn from random.
+  static vector<City> randomCities(const unsigned int &w, const unsigned int &h, const unsigned int &n, Random &random)
+  {
+   vector<City> cities;
+   unordered_set<City, CityHash> added; // These are the cities added so far, so that checking for a duplicate takes constant time.
+
+   // Keep adding random cities until we have n of them.
+   while (cities.size() < n)
+   {
+    City city(w, h, random); // Create a random city.
+    if (added.insert(city).second) // Check whether this random city has already been added.
+    {
+     cities.push_back(city); // If this random city is distinct from those cities already added, then add it.
+    }
+   }
+
+   return cities;
+  }
+ public:
+
+  // Create a map of the given cities, which should be distinct, and of which there should be at least one.
+  // The distances between the cities are recorded in a table laid out according to storage and precision.
+  // With INTEGER_PRECISION, the table holds the distances multiplied by scale and rounded, and the largest of these should be less than 2^31.
+  // The cities are numbered in the indicated order; originalIndex tells which of the given cities each one was.
+  // The cities are also indexed by a grid, from which we find the n_neighbors nearest neighbors of each city, and they are triangulated.
+  BasicMap(const vector<City> &cities, const DistanceStorage &storage = FULL_MATRIX, const DistancePrecision &precision = DOUBLE_PRECISION, const unsigned int &n_neighbors = 10, const double &scale = 1, const CityOrder &order = GENERATION_ORDER) : vector<City>(cities), _width(0), _height(0), _storage(storage), _precision(precision), _scale(scale)
+  {
+   long long min_x = cities[0].x, max_x = cities[0].x, min_y = cities[0].y, max_y = cities[0].y;
+   for (unsigned int i = 1; i < cities.size(); i ++)
+   {
+    min_x = min(min_x, cities[i].x);
+    max_x = max(max_x, cities[i].x);
+    min_y = min(min_y, cities[i].y);
+    max_y = max(max_y, cities[i].y);
+   }
+   _width = static_cast<unsigned int>(min<unsigned long long>(0xffffffff, static_cast<unsigned long long>(max_x - min_x) + 1));
+   _height = static_cast<unsigned int>(min<unsigned long long>(0xffffffff, static_cast<unsigned long long>(max_y - min_y) + 1));
+
+   renumber(order);
+
+#ifdef GA_CACHE_STATISTICS
+   _hits = 0;
+   _misses = 0;
+#endif
+
+   buildDistanceTable();
+
+   for (unsigned int i = 0; i < size(); i ++)
+   {
+    _xs.push_back((*this)[i].x);
+    _ys.push_back((*this)[i].y);
+   }
+
+   index = GridIndex(*this);
+   buildNearestNeighbors(n_neighbors);
+   _delaunay = CandidateGraph(DelaunayTriangulation(*this).neighbors());
+   _combined = unite(_delaunay, _nearest);
+
+   if (_storage == NEIGHBOR_CACHE)
+   {
+    buildNeighborCache();
+   }
+  }
+
+  // Create a map of width w and height h, containing n distinct, random cities drawn from random.
+  // The parameters w, h, and n should all be positive integers.
+  // Everything else is as above.
+  BasicMap(const unsigned int &w, const unsigned int &h, const unsigned int &n, Random &random, const DistanceStorage &storage = FULL_MATRIX, const DistancePrecision &precision = DOUBLE_PRECISION, const unsigned int &n_neighbors = 10, const double &scale = 1, const CityOrder &order = GENERATION_ORDER) : BasicMap(randomCities(w, h, n, random), storage, precision, n_neighbors, scale, order)
+  {
+   _width = w;
+   _height = h;
+  }
+
+  // The index refers to the cities of this map, so a copy of the map needs an index of its own.
+  BasicMap(const BasicMap &map) : vector<City>(map), _width(map._width), _height(map._height), _storage(map._storage), _precision(map._precision), _scale(map._scale), _distances(map._distances), _distances_float(map._distances_float), _distances_integer(map._distances_integer), _row_offsets(map._row_offsets), _lines(map._lines.size()), _original(map._original), _xs(map._xs), _ys(map._ys), index(*this), _nearest(map._nearest), _delaunay(map._delaunay), _combined(map._combined)
+  {
+#ifdef GA_CACHE_STATISTICS
+   _hits = 0;
+   _misses = 0;
+#endif
+
+   // The copy's lines may start at a different offset from the first cache line boundary, so we copy them one at a time.
+   for (unsigned int i = 0; i < size() && !_lines.empty(); i ++)
+   {
+    line(i) = map.line(i);
+   }
+  }
+
+  BasicMap &operator =(const BasicMap &) = delete;
+
+  // The cities on our map are recorded in a vector of cities.
+  // This function returns the distance between the city at index i and the city at index j, according to Metric.
+  // The parameters i and j should be in [0, size()).
+  // We look the distance up in the table (or in the neighbor cache, computing it only if it is not there), rather than computing it.
+  double distance(const unsigned int &i, const unsigned int &j) const
+  {
+   if (i == j) // The triangular table has no diagonal, so we handle this case here.
+   {
+    return 0;
+   }
+   if (_storage == NEIGHBOR_CACHE)
+   {
+    return cachedDistance(i, j);
+   }
+   if (_precision == DOUBLE_PRECISION)
+   {
+    return _distances[entry(i, j)];
+   }
+   if (_precision == SINGLE_PRECISION)
+   {
+    return _distances_float[entry(i, j)];
+   }
+   return _distances_integer[entry(i, j)];
+  }
+
+  DistanceStorage storage() const
+  {
+   return _storage;
+  }
+
+  DistancePrecision precision() const
+  {
+   return _precision;
+  }
+
+  double scale() const
+  {
+   return _scale;
+  }
+
+  // Return the index that the city at index i had before the cities were renumbered, i.e., the number of the city in the order in which the cities were made.
+  unsigned int originalIndex(const unsigned int &i) const
+  {
+   return _original[i];
+  }
+
+#ifdef GA_CACHE_STATISTICS
+  // Return the number of distances looked up in the neighbor cache so far, and the fraction of them that were found there.
+  // Counting every lookup from every thread would slow the innermost loops down, so the lookups are only counted, and these only exist, if we compile with -DGA_CACHE_STATISTICS.
+  unsigned long long cacheLookups() const
+  {
+   return _hits + _misses;
+  }
+
+  double cacheHitRate() const
+  {
+   unsigned long long hits = _hits, lookups = hits + _misses;
+   return lookups == 0 ? 0 : static_cast<double>(hits) / lookups;
+  }
+#endif
+
+  // Return how far a length that was updated move by move may be from the same length measured from scratch (see GA_CHECK_DELTAS).
+  // Whole numbers add up exactly, so with INTEGER_PRECISION the two must be equal.
+  double tolerance(const double &length) const
+  {
+   return _precision == INTEGER_PRECISION ? 0 : 1e-9 * max(1.0, length);
+  }
+
+  unsigned int width() const
+  {
+   return _width;
+  }
+
+  unsigned int height() const
+  {
+   return _height;
+  }
+
+  // Return the lists of nearest neighbors, found when the map was created.
+  const CandidateGraph &nearestNeighbors() const
+  {
+   return _nearest;
+  }
+
+  // Return the indicated candidate graph, found when the map was created.
+  const CandidateGraph &candidates(const CandidateSet &set) const
+  {
+   switch (set)
+   {
+    case NEAREST_CANDIDATES:
+     return _nearest;
+    case DELAUNAY_CANDIDATES:
+     return _delaunay;
+    default:
+     return _combined;
+   }
+  }
+
+  // Return the length of the itinerary of the n cities at cities, computed by the fastest length kernel for Metric.
+  template <class Index>
+  double lengthOfItinerary(const Index *cities, const unsigned int &n) const
+  {
+   if (_precision == INTEGER_PRECISION) // The kernels do not round as the table does, so we add up the distances one by one, as 64-bit integers.
+   {
+    long long length = 0;
+    for (unsigned int e = 0; e < n; e ++)
+    {
+     length += static_cast<long long>(distance(cities[e], cities[e + 1 < n ? e + 1 : 0]));
+    }
+    return static_cast<double>(length);
+   }
+   if (!Metric::euclidean)
+   {
+    return lengthWithMetric<Metric>(data(), cities, n, _precision == SINGLE_PRECISION);
+   }
+   return lengthKernel<Index>()(_xs.data(), _ys.data(), cities, n, _precision == SINGLE_PRECISION);
+  }
+
+  // Put the lengths of the n_itineraries itineraries of n cities each, stored one after another at cities, in lengths, computed by the fastest batch kernel.
+  template <class Index>
+  void lengthsOfItineraries(const Index *cities, const unsigned int &n_itineraries, const unsigned int &n, double *lengths) const
+  {
+   if (_precision == INTEGER_PRECISION || !Metric::euclidean)
+   {
+    for (unsigned int t = 0; t < n_itineraries; t ++)
+    {
+     lengths[t] = lengthOfItinerary(cities + static_cast<size_t>(t) * n, n);
+    }
+    return;
+   }
+   batchLengthKernel<Index>()(_xs.data(), _ys.data(), cities, n_itineraries, n, _precision == SINGLE_PRECISION, lengths);
+  }
+
+  // Put the k cities nearest to city i, nearest first, in nearest.
+  void nearest(const unsigned int &i, const unsigned int &k, vector<unsigned int> &nearest) const
+  {
+   index.nearest(i, k, nearest);
+  }
+};
+
+typedef BasicMap<EuclideanMetric> Map;
+
+// The parameter itinerary, which in the following function is a vector of unsigned integers (or a view of one), indicates the order in which the cities on our map are to be visited.
+// If N is equal to map.size(), then any itinerary we would like to consider is just a permutation of the N-1 last elements of the ordered set (0, 1, ..., N-1).
+// Return the length of the itinerary according to the map's metric, beginning and ending at the city map[itinerary[0]].
+// The itinerary must be stored contiguously, so that the map's length kernel can read it directly.
+template <class Itinerary, class Metric>
+double lengthOfItinerary(const Itinerary &itinerary, const BasicMap<Metric> &map)
+{
+ return map.lengthOfItinerary(&itinerary[0], itinerary.size());
+}
+
+// A tour is an itinerary together with the itinerary's Euclidean length.
+// The itinerary will be followed, starting with the city indicated by its first element and finishing at the same city.
+// Hence, the itinerary forms a closed path.
+// Any cyclic permutation of the itinerary determines the same closed path, so we kill this redundancy by requiring all itineraries to have the same first element.
+// The reason we record the length, and not just the itinerary, is that we want to avoid having to compute the length each time we need it.
+
+// A tour view refers to an itinerary and its length without owning them.
+// They may belong to a Tour, or they may be a row of a TourArena, in which many tours share one block of memory.
+// Views are cheap to copy, and they are valid as long as the memory they refer to.
+// Like tours, views are templates on the type Index of the city numbers (see BasicTour).
+template <class Index>
+class BasicConstTourView {
+ private:
+  const Index *_cities;
+  unsigned int _size;
+  const double *_length;
+ public:
+
+  BasicConstTourView(const Index *cities, const unsigned int &size, const double *length) : _cities(cities), _size(size), _length(length)
+  {
+  }
+
+  const Index &operator [](const unsigned int &i) const
+  {
+   return _cities[i];
+  }
+
+  unsigned int size() const
+  {
+   return _size;
+  }
+
+  const Index *begin() const
+  {
+   return _cities;
+  }
+
+  const Index *end() const
+  {
+   return _cities + _size;
+  }
+
+  const Index &back() const
+  {
+   return _cities[_size - 1];
+  }
+
+  const double &length() const
+  {
+   return *_length;
+  }
+};
+
+typedef BasicConstTourView<unsigned int> ConstTourView;
+
+// Two views are equal if they refer to the same itinerary (possibly stored in different places).
+template <class Index>
+bool operator ==(const BasicConstTourView<Index> &a, const BasicConstTourView<Index> &b)
+{
+ return a.size() == b.size() && equal(a.begin(), a.end(), b.begin());
+}
+
+template <class Index>
+bool operator !=(const BasicConstTourView<Index> &a, const BasicConstTourView<Index> &b)
+{
+ return !(a == b);
+}
+
+// This is the same as < for tours, below.
+template <class Index>
+bool operator <(const BasicConstTourView<Index> &a, const BasicConstTourView<Index> &b)
+{
+ return a.length() > b.length();
+}
+
+// This view can also change the itinerary to which it refers.
+// When it does, it updates the length from just the edges that were removed and added.
+// Compile with -DGA_CHECK_DELTAS to compare every such update with a full recomputation of the length.
+template <class Index>
+class BasicTourView {
+ private:
+  typedef BasicConstTourView<Index> ConstTourView;
+
+  Index *_cities;
+  unsigned int _size;
+  double *_length;
+
+  // Return the city visited after the one at index i, remembering that the itinerary is a closed path.
+  unsigned int after(const unsigned int &i) const
+  {
+   return i + 1 < _size ? _cities[i + 1] : _cities[0];
+  }
+
+ public:
+
+  BasicTourView(Index *cities, const unsigned int &size, double *length) : _cities(cities), _size(size), _length(length)
+  {
+  }
+
+  operator ConstTourView() const
+  {
+   return ConstTourView(_cities, _size, _length);
+  }
+
+  Index &operator [](const unsigned int &i) const
+  {
+   return _cities[i];
+  }
+
+  unsigned int size() const
+  {
+   return _size;
+  }
+
+  Index *begin() const
+  {
+   return _cities;
+  }
+
+  Index *end() const
+  {
+   return _cities + _size;
+  }
+
+  Index &back() const
+  {
+   return _cities[_size - 1];
+  }
+
+  const double &length() const
+  {
+   return *_length;
+  }
+
+  // Record the length of the itinerary.
+  // Whoever writes the itinerary by hand (e.g., sex) is responsible for this.
+  void setLength(const double &length)
+  {
+   *_length = length;
+  }
+
+  // Every change to the itinerary reports here how much it changed the length.
+  // (That includes changes made from outside, e.g., by local search.)
+  template <class Metric>
+  void changeLength(const double &delta, const BasicMap<Metric> &map)
+  {
+   *_length += delta;
+
+#ifdef GA_CHECK_DELTAS
+   double length = lengthOfItinerary(*this, map);
+   if (fabs(*_length - length) > map.tolerance(length))
+   {
+    cerr << "Tour length drifted: updated to " << *_length << ", but recomputed as " << length << '.' << endl;
+    abort();
+   }
+#else
+   (void)map; // The map is only needed for the check.
+#endif
+
+   return;
+  }
+
+  // Copy the itinerary and length of tour, which must have the same number of cities.
+  void assign(const ConstTourView &tour)
+  {
+   copy(tour.begin(), tour.end(), _cities);
+   *_length = tour.length();
+  }
+
+  // The following moves change the itinerary and update its length in constant time (except for the work of moving the cities themselves).
+  // The indices are positions in the itinerary, and they should be in [1, size()), so that the first city never moves.
+
+  // Swap the cities at indices i < j.
+  template <class Metric>
+  void swapCities(const unsigned int &i, const unsigned int &j, const BasicMap<Metric> &map)
+  {
+   unsigned int a = (*this)[i - 1]; // This city comes before the one at index i.
+   unsigned int x = (*this)[i];
+   unsigned int y = (*this)[j];
+   unsigned int b = after(j); // This city comes after the one at index j.
+   double delta;
+
+   if (j == i + 1) // The cities are neighbors, so the edge between them survives the swap.
+   {
+    delta = map.distance(a, y) + map.distance(x, b) - map.distance(a, x) - map.distance(y, b);
+   }
+   else // Each city moves into the other's pair of edges.
+   {
+    unsigned int c = (*this)[i + 1];
+    unsigned int d = (*this)[j - 1];
+    delta = map.distance(a, y) + map.distance(y, c) + map.distance(d, x) + map.distance(x, b)
+          - map.distance(a, x) - map.distance(x, c) - map.distance(d, y) - map.distance(y, b);
+   }
+
+   ::swap((*this)[i], (*this)[j]);
+   changeLength(delta, map);
+
+   return;
+  }
+
+  // Reverse the order of the cities at indices i through j, where i < j.
+  // Only the edges at either end of the reversed subsequence change.
+  template <class Metric>
+  void reverseCities(const unsigned int &i, const unsigned int &j, const BasicMap<Metric> &map)
+  {
+   unsigned int a = (*this)[i - 1];
+   unsigned int x = (*this)[i];
+   unsigned int y = (*this)[j];
+   unsigned int b = after(j);
+   double delta = map.distance(a, y) + map.distance(x, b) - map.distance(a, x) - map.distance(y, b);
+
+   reverse(_cities + i, _cities + j + 1);
+   changeLength(delta, map);
+
+   return;
+  }
+
+  // Rotate the cities at indices i through j, so that the city at index k, where i < k <= j, moves to index i.
+  // In other words, swap the adjacent subsequences [i, k) and [k, j].
+  template <class Metric>
+  void rotateCities(const unsigned int &i, const unsigned int &k, const unsigned int &j, const BasicMap<Metric> &map)
+  {
+   unsigned int a = (*this)[i - 1];
+   unsigned int x = (*this)[i]; // This is the start of the first subsequence...
+   unsigned int y = (*this)[k - 1]; // ... and this is its end.
+   unsigned int z = (*this)[k]; // This is the start of the second subsequence...
+   unsigned int w = (*this)[j]; // ... and this is its end.
+   unsigned int b = after(j);
+   double delta = map.distance(a, z) + map.distance(w, x) + map.distance(y, b) - map.distance(a, x) - map.distance(y, z) - map.distance(w, b);
+
+   rotate(_cities + i, _cities + k, _cities + j + 1);
+   changeLength(delta, map);
+
+   return;
+  }
+
+  // Consider three kinds of changes (i.e., mutations) to an itinerary that can shorten it.
+  // One way is to swap two cities.
+  // Another way is to reverse the order of a subsequence of cities.
+  // Yet one more way is to apply a cyclic permutation to a subsequence of cities.
+  // The parameter p in [0, 1] indicates the probability with which a mutation occurs.
+  // Since we are dealing with tours, not just itineraries, we want to record the length of the mutated itinerary; this requires that we have the corresponding map as well.
+  // Only two to four edges change, so we update the length from those edges rather than walking the whole itinerary again.
+  // Return the type of mutation that we performed.
+  // (At the moment, nothing in this program actually cares what kind of mutation we performed, but it might be interesting to keep a record of it in a later version of this program.)
+  template <class Metric>
+  int mutate(const double &p, const BasicMap<Metric> &map, Random &random)
+  {
+   // Randomly decide whether to perform a mutation.
+   if (random.real(0, 1) > p) // In this case, don't perform a mutation.
+   {
+    return -1;
+   }
+
+   int mutation; // The is where we will record the type of mutation performed.
+   // The meaning of the integer mutation is indicated in the switch statement below.
+
+   // Get random indices i and j in [1, size()), with i < j.
+   unsigned int i = random.index(1, _size - 1);
+   unsigned int j = random.index(i + 1, _size);
+
+   // Given any indices i and j as above, we can certainly perform swap and reverse mutations.
+   // However, a rotation requires that there is some index in between i and j.
+   while (true)
+   {
+    mutation = random.index(0, 3); // Randomly choose a mutation type.
+
+    // Try to perform a mutation.
+    // Each move updates the length of the tour from the few edges that it changes.
+    switch (mutation)
+    {
+     case 0:
+      swapCities(i, j, map);
+     break;
+     case 1:
+      reverseCities(i, j, map);
+     break;
+     case 2:
+      if (j - i > 2) // If there is an index in between i and j, perform a rotation.
+      {
+       rotateCities(i, random.index(i + 1, j), j, map); // Randomly choose an index in between i and j, and perform the corresponding rotation.
+      }
+      else // In this case, i and j are consecutive, so we can only hope to do a swap or reverse mutation.
+      {
+       continue; // Go back to the beginning: Randomly choose a mutation, and see if we can perform it.
+      }
+     break;
+    }
+
+    // If we reach this point, we have successfully performed a mutation.
+    break; // Don't try to perform any more mutations.
+   }
+
+   return mutation; // Return the type of mutation.
+  }
+};
+
+typedef BasicTourView<unsigned int> TourView;
+
+// A tour owns its itinerary, which it keeps in a vector, together with the itinerary's length.
+// Everything that changes a tour is done through a view of it, so that the same code serves tours and the rows of a TourArena.
+// The cities are numbered by Index, which must be an unsigned integer type that can number every city of the map.
+// A Tour numbers them with unsigned int, but a map of up to 65536 cities can use uint16_t, which halves the memory of the tours and puts twice as many cities in each cache line (see BasicAdaptivePopulation).
+template <class Index>
+class BasicTour : public vector<Index> {
+ private:
+  typedef BasicConstTourView<Index> ConstTourView;
+  typedef BasicTourView<Index> TourView;
+
+  double _length;
+ public:
+
+  // Create an empty tour, to be filled in later (e.g., by sex).
+  BasicTour() : _length(0)
+  {
+  }
+
+  // Create a random tour of the cities in map, using random.
+  template <class Metric>
+  BasicTour(const BasicMap<Metric> &map, Random &random)
+  {
+   // Add the numbers 0, 1, ..., map.size()-1 to the itinerary on which this tour is based.
+   unsigned int i;
+   for (i = 0; i < map.size(); i ++)
+   {
+    this->push_back(i);
+   }
+
+   // Make the itinerary random by shuffling all but the first element.
+   // We shuffle by hand (this is the Fisher-Yates shuffle), since the standard library does not promise the same shuffle everywhere.
+   for (i = this->size() - 1; i > 1; i --)
+   {
+    ::swap((*this)[i], (*this)[random.index(1, i + 1)]);
+   }
+
+   _length = lengthOfItinerary(*this, map); // Record the length of the resulting itinerary.
+  }
+
+  // Create a tour based on itinerary and map.
+  template <class Metric>
+  BasicTour(const vector<unsigned int> &itinerary, const BasicMap<Metric> &map)
+  {
+   this->assign(itinerary.begin(), itinerary.end()); // Record the indicated itinerary.
+
+   _length = lengthOfItinerary(*this, map);// Record the length of the itinerary.
+  }
+
+  // Create a copy of the tour to which view refers, whose cities may be numbered by another type.
+  template <class Other>
+  explicit BasicTour(const BasicConstTourView<Other> &view) : vector<Index>(view.begin(), view.end()), _length(view.length())
+  {
+  }
+
+  const double &length() const
+  {
+   return _length;
+  }
+
+  // Return a view of this tour.
+  // The view is invalidated if the number of cities changes.
+  TourView view()
+  {
+   return TourView(this->data(), this->size(), &_length);
+  }
+
+  ConstTourView view() const
+  {
+   return ConstTourView(this->data(), this->size(), &_length);
+  }
+
+  operator ConstTourView() const
+  {
+   return view();
+  }
+
+  // The moves and mutations are those of TourView.
+
+  template <class Metric>
+  void swapCities(const unsigned int &i, const unsigned int &j, const BasicMap<Metric> &map)
+  {
+   view().swapCities(i, j, map);
+  }
+
+  template <class Metric>
+  void reverseCities(const unsigned int &i, const unsigned int &j, const BasicMap<Metric> &map)
+  {
+   view().reverseCities(i, j, map);
+  }
+
+  template <class Metric>
+  void rotateCities(const unsigned int &i, const unsigned int &k, const unsigned int &j, const BasicMap<Metric> &map)
+  {
+   view().rotateCities(i, k, j, map);
+  }
+
+  template <class Metric>
+  int mutate(const double &p, const BasicMap<Metric> &map, Random &random)
+  {
+   return view().mutate(p, map, random);
+  }
+};
+
+typedef BasicTour<unsigned int> Tour;
+
+// Take two tours as parameters, and combine them to make a better tour.
+// The algorithm to construct the child's itinerary from a and b is straightforward:
+/*
+ 1) Add the initial city (i.e., the city from which all tours begin and end), to itinerary.
+ 2) Find the first cities from a and b that haven't been added to itinerary.
+ 3) Among these two cities, add to itinerary the one nearer to the last citi in itinerary.
+ 4) Go back to step (2).
+*/
+// Clearly, the resulting itinerary can be no worse than the shorter of a and b.
+// (Call the function sex for fun!)
+// Tours a and b should both be based on map, and child should be a view of map.size() cities, distinct from those of a and b.
+// The child is written over, so that its memory can be reused from one generation to the next.
+// We remember which cities have been added in visited, so that each step of the algorithm takes constant time, and we add up the length of the child as we go.
+// The caller provides visited, too, so that it can be reused.
+template <class Index, class Metric>
+void sex(const BasicConstTourView<Index> &a, const BasicConstTourView<Index> &b, const BasicMap<Metric> &map, BasicTourView<Index> child, vector<bool> &visited)
+{
+ const unsigned int n = map.size();
+ unsigned int i = 1; // This is the position from which we should begin searching a.
+ unsigned int j = 1; // This is the position from which we should begin searching b.
+ unsigned int k; // This is the position in child that we are filling.
+ double length = 0; // This is the length of the child's itinerary so far.
+
+ visited.assign(n, false);
+
+ child[0] = a[0]; // Set the first city to be the same as the first city of all the itineraries under consideration.
+ visited[child[0]] = true;
+
+ for (k = 1; k < n; k ++)
+ {
+  // In what follows, a legitimate city is one that has not been visited yet.
+
+  // Find next legitimate city in a.
+  while (i < n && visited[a[i]])
+  {
+   i ++;
+  }
+  // Now, either i is equal to n, or a[i] is the next legitimate city in a.
+
+  // Do the same thing for b.
+  while (j < n && visited[b[j]])
+  {
+   j ++;
+  }
+
+  unsigned int last = child[k - 1]; // This is the last city added to the child.
+  double edge; // This is the length of the edge from last to the city we add.
+
+  if (i == n) // We've reached the end of a, so the only remaining cities to add are those in b.
+  {
+   child[k] = b[j]; // Add the next legitimate city in b.
+   edge = map.distance(last, b[j]);
+   j ++;
+  }
+  else if (j == n) // We've reached the end of b, so the only remaining cities to add are those in a.
+  {
+   child[k] = a[i]; // Add the next legitimate city in a.
+   edge = map.distance(last, a[i]);
+   i ++;
+  }
+  else // We've reached the end of neither a nor b.
+  {
+   // Add the next legitimate city from a or b nearest to the last city added to the child.
+   double length_a = map.distance(last, a[i]);
+   double length_b = map.distance(last, b[j]);
+   if (length_a < length_b) // The next legitimate city from a is closer.
+   {
+    child[k] = a[i];
+    edge = length_a;
+    i ++;
+   }
+   else // The next legitimate city from b is no worse than that of a.
+   {
+    child[k] = b[j];
+    edge = length_b;
+    j ++;
+   }
+  }
+
+  visited[child[k]] = true;
+  length += edge;
+
+  // Repeat this whole process until the child visits every city.
+ }
+
+ length += map.distance(child[n - 1], child[0]); // Close the path.
+ child.setLength(length);
+
+ return;
+}
+
+// This is the same as above, but it returns a new child.
+template <class Index, class Metric>
+BasicTour<Index> sex(const BasicConstTourView<Index> &a, const BasicConstTourView<Index> &b, const BasicMap<Metric> &map)
+{
+ BasicTour<Index> child;
+ vector<bool> visited;
+ child.resize(map.size());
+ sex(a, b, map, child.view(), visited);
+ return child;
+}
+
+// These are the same as above, for cities numbered with unsigned int.
+// Deducing Index ignores conversions, so without them, tours (which convert to views) could not be passed directly.
+template <class Metric>
+void sex(const ConstTourView &a, const ConstTourView &b, const BasicMap<Metric> &map, TourView child, vector<bool> &visited)
+{
+ sex<unsigned int, Metric>(a, b, map, child, visited);
+}
+
+template <class Metric>
+Tour sex(const ConstTourView &a, const ConstTourView &b, const BasicMap<Metric> &map)
+{
+ return sex<unsigned int, Metric>(a, b, map);
+}
+
+// We have to define < in order to use max_element.
+template <class Index>
+bool operator <(const BasicTour<Index> &a, const BasicTour<Index> &b)
+{
+ return a.length() > b.length(); // This is equivalent to returning 1 / a.length() < 1 / b.length().
+}
+
+// A tour arena stores many tours, each visiting the same number of cities, in one contiguous block of memory.
+// The itineraries are the rows of an array with one row per tour, and their lengths are kept in a parallel array.
+// Compared with a vector of tours, each owning its own block of memory, this keeps the whole population together, so that it is allocated once and read predictably.
+// The tours themselves are accessed through views.
+template <class Index>
+class BasicTourArena {
+ private:
+  typedef BasicConstTourView<Index> ConstTourView;
+  typedef BasicTourView<Index> TourView;
+
+  unsigned int _n_cities;
+  vector<Index> cities; // The itinerary of tour k occupies cities[k * _n_cities], ..., cities[(k + 1) * _n_cities - 1].
+  vector<double> _lengths;
+ public:
+
+  // Create an arena for n_tours tours of n_cities cities each.
+  BasicTourArena(const unsigned int &n_tours, const unsigned int &n_cities) : _n_cities(n_cities), cities(static_cast<size_t>(n_tours) * n_cities), _lengths(n_tours)
+  {
+  }
+
+  // Return the number of tours.
+  unsigned int size() const
+  {
+   return _lengths.size();
+  }
+
+  unsigned int nCities() const
+  {
+   return _n_cities;
+  }
+
+  TourView operator [](const unsigned int &k)
+  {
+   return TourView(&cities[static_cast<size_t>(k) * _n_cities], _n_cities, &_lengths[k]);
+  }
+
+  ConstTourView operator [](const unsigned int &k) const
+  {
+   return ConstTourView(&cities[static_cast<size_t>(k) * _n_cities], _n_cities, &_lengths[k]);
+  }
+
+  // Return the lengths of all of the tours.
+  // Anything that only needs the lengths (e.g., choosing parents) can stream through this array without touching the itineraries.
+  const vector<double> &lengths() const
+  {
+   return _lengths;
+  }
+
+  // Recompute the lengths of all of the tours from scratch, which undoes any drift of the lengths that were updated move by move.
+  // The tours are measured together, several at a time (see BatchLengthKernel).
+  // Compile with -DGA_CHECK_DELTAS to check that no length had drifted much.
+  template <class Metric>
+  void measure(const BasicMap<Metric> &map)
+  {
+#ifdef GA_CHECK_DELTAS
+   vector<double> old_lengths = _lengths;
+#endif
+
+   map.lengthsOfItineraries(cities.data(), size(), _n_cities, _lengths.data());
+
+#ifdef GA_CHECK_DELTAS
+   for (unsigned int k = 0; k < size(); k ++)
+   {
+    if (fabs(old_lengths[k] - _lengths[k]) > map.tolerance(_lengths[k]))
+    {
+     cerr << "Tour length drifted: tour " << k << " was updated to " << old_lengths[k] << ", but measured as " << _lengths[k] << '.' << endl;
+     abort();
+    }
+   }
+#endif
+
+   return;
+  }
+
+  // Exchange the tours of this arena with those of other, without copying them.
+  void swap(BasicTourArena &other)
+  {
+   ::swap(_n_cities, other._n_cities);
+   cities.swap(other.cities);
+   _lengths.swap(other._lengths);
+  }
+};
+
+typedef BasicTourArena<unsigned int> TourArena;
+
+// Local search improves a single tour until no move of a given kind makes it shorter, i.e., until the tour is a local optimum.
+// It is much faster than random mutation at finding what is nearby, so it can be used on its own, or on every child in the genetic algorithm (which is then called a memetic algorithm).
+// The optimizers work on the tour in an Order, which is either a TourOrder (an array, the default) or a TwoLevelList (for huge maps, e.g., BasicLinKernighan<TwoLevelList>), and they measure distances with the Metric of the map (EuclideanMetric by default).
+
+// A tour order records the cities of a tour in order, together with the position of each city, so that we can find the cities before and after any city in constant time.
+// Reversing a path takes time proportional to the length of the path, but we always reverse whichever of the path and the rest of the tour is shorter (both give the same closed path).
+class TourOrder {
+ private:
+  vector<unsigned int> order; // These are the cities in tour order...
+  vector<unsigned int> pos; // ... and city c is at order[pos[c]].
+  unsigned int first; // This is the city with which the itinerary began.
+ public:
+
+  TourOrder() : first(0)
+  {
+  }
+
+  // Record the order of the cities in tour.
+  template <class Itinerary>
+  void load(const Itinerary &tour)
+  {
+   order.assign(tour.begin(), tour.end());
+   pos.resize(order.size());
+   for (unsigned int i = 0; i < order.size(); i ++)
+   {
+    pos[order[i]] = i;
+   }
+   first = order[0];
+  }
+
+  // Write the order of the cities into tour, beginning with the city with which the loaded itinerary began.
+  // The length of tour is left alone.
+  template <class Index>
+  void store(BasicTourView<Index> tour) const
+  {
+   unsigned int c = first;
+   for (unsigned int i = 0; i < order.size(); i ++)
+   {
+    tour[i] = c;
+    c = next(c);
+   }
+  }
+
+  unsigned int size() const
+  {
+   return order.size();
+  }
+
+  // Return the city after c.
+  unsigned int next(const unsigned int &c) const
+  {
+   unsigned int i = pos[c] + 1;
+   return order[i == order.size() ? 0 : i];
+  }
+
+  // Return the city before c.
+  unsigned int prev(const unsigned int &c) const
+  {
+   unsigned int i = pos[c];
+   return order[i == 0 ? order.size() - 1 : i - 1];
+  }
+
+  // Return whether b is met on the way forward from a to c (counting a and c).
+  bool between(const unsigned int &a, const unsigned int &b, const unsigned int &c) const
+  {
+   unsigned int i = pos[a], j = pos[b], k = pos[c];
+   return i <= k ? i <= j && j <= k : i <= j || j <= k;
+  }
+
+  // Reverse the path going forward from city a to city b.
+  void reverse(const unsigned int &a, const unsigned int &b)
+  {
+   const unsigned int n = order.size();
+   unsigned int i = pos[a], j = pos[b];
+   unsigned int length = (j + n - i) % n + 1;
+
+   // Reversing the rest of the tour instead gives the same closed path.
+   if (2 * length > n)
+   {
+    i = j + 1 == n ? 0 : j + 1;
+    j = pos[a] == 0 ? n - 1 : pos[a] - 1;
+    length = n - length;
+   }
+
+   for (unsigned int k = 0; k < length / 2; k ++)
+   {
+    ::swap(order[i], order[j]);
+    pos[order[i]] = i;
+    pos[order[j]] = j;
+    i = i + 1 == n ? 0 : i + 1;
+    j = j == 0 ? n - 1 : j - 1;
+   }
+  }
+
+  // Replace the edges (a, b) and (c, d) with (a, c) and (b, d), where b follows a and d follows c in the same direction around the tour (forward or backward).
+  // This is a 2-opt move; other moves are made of several of them, and since reverse may turn the whole tour around, they should only be described this way, not by forward paths.
+  void move(const unsigned int &a, const unsigned int &b, const unsigned int &c, const unsigned int &d)
+  {
+   if (next(a) == b)
+   {
+    reverse(b, c);
+   }
+   else
+   {
+    reverse(c, b);
+   }
+   (void)d; // The edge (c, d) is determined by c and the direction.
+  }
+};
+
+// A two-level list records the cities of a tour in the same way as a tour order, but reversing a path only takes time proportional to the square root of the number of cities (as described by Fredman, Johnson, McGeoch and Ostheimer).
+// The tour is cut into about sqrt(N) segments, each a doubly-linked list of cities with a bit that says whether it is reversed, and the segments themselves form a doubly-linked ring.
+// A long path is reversed by splitting the segments at its ends and reversing the segments between them, which only flips their bits; a short path is reversed within its segment.
+// Finding the cities before and after a city, and checking whether a city is between two others, still take constant time.
+// For tours of a few thousand cities, a tour order is faster; for a million cities, reversing half of an array at every move is hopeless, and this is the way to go.
+class TwoLevelList {
+ private:
+  // Within a segment, the cities are linked in the segment's own direction, from first to last, with increasing ranks.
+  // If the segment is reversed, the tour runs through it from last to first.
+  vector<unsigned int> city_next;
+  vector<unsigned int> city_prev;
+  vector<unsigned int> parent; // This is the segment of each city.
+  vector<int> rank;
+
+  // The segments are linked in the tour's direction, and their ranks increase going forward (wrapping around once).
+  vector<unsigned int> segment_next;
+  vector<unsigned int> segment_prev;
+  vector<bool> reversed;
+  vector<unsigned int> first;
+  vector<unsigned int> last;
+  vector<unsigned int> count;
+  vector<int> segment_rank;
+
+  unsigned int group; // This is the number of cities per segment that we aim for.
+  unsigned int start; // This is the city with which the itinerary began.
+  bool unbalanced; // This is set when a segment has grown too large.
+
+  vector<unsigned int> part; // This is room for the cities being moved or reversed within a segment...
+  vector<unsigned int> run; // ... and for the segments being reversed.
+
+  // Return the first and last cities of segment s, in the tour's direction.
+  unsigned int head(const unsigned int &s) const
+  {
+   return reversed[s] ? last[s] : first[s];
+  }
+
+  unsigned int tail(const unsigned int &s) const
+  {
+   return reversed[s] ? first[s] : last[s];
+  }
+
+  // Return the position of city c within its segment, increasing in the tour's direction.
+  int position(const unsigned int &c) const
+  {
+   return reversed[parent[c]] ? -rank[c] : rank[c];
+  }
+
+  // Return whether city c comes before or at city d, where both are in the same segment.
+  bool before(const unsigned int &c, const unsigned int &d) const
+  {
+   return position(c) <= position(d);
+  }
+
+  // Number the cities of segment s in order, from first to last.
+  void renumber(const unsigned int &s)
+  {
+   int r = 0;
+   for (unsigned int c = first[s]; ; c = city_next[c])
+   {
+    rank[c] = r ++;
+    parent[c] = s;
+    if (c == last[s])
+    {
+     break;
+    }
+   }
+  }
+
+  // Cut the tour, beginning with city c, into segments of group cities each (except perhaps the last), none of them reversed.
+  void cut(unsigned int c)
+  {
+   const unsigned int n = city_next.size();
+   const unsigned int n_segments = (n + group - 1) / group;
+
+   // Collect the cities in order before relinking them.
+   part.resize(n);
+   for (unsigned int i = 0; i < n; i ++)
+   {
+    part[i] = c;
+    c = next(c);
+   }
+
+   segment_next.resize(n_segments);
+   segment_prev.resize(n_segments);
+   reversed.assign(n_segments, false);
+   first.resize(n_segments);
+   last.resize(n_segments);
+   count.resize(n_segments);
+   segment_rank.resize(n_segments);
+   for (unsigned int s = 0; s < n_segments; s ++)
+   {
+    unsigned int i0 = s * group, i1 = min(n, i0 + group);
+    for (unsigned int i = i0; i < i1; i ++)
+    {
+     city_prev[part[i]] = i > i0 ? part[i - 1] : part[i];
+     city_next[part[i]] = i + 1 < i1 ? part[i + 1] : part[i];
+    }
+    first[s] = part[i0];
+    last[s] = part[i1 - 1];
+    count[s] = i1 - i0;
+    segment_next[s] = s + 1 == n_segments ? 0 : s + 1;
+    segment_prev[s] = s == 0 ? n_segments - 1 : s - 1;
+    segment_rank[s] = s;
+    renumber(s);
+   }
+  }
+
+  // Reverse the path from a to b, both in segment s, with a before b.
+  void reverseWithin(const unsigned int &s, const unsigned int &a, const unsigned int &b)
+  {
+   if (a == head(s) && b == tail(s))
+   {
+    reversed[s] = !reversed[s];
+    return;
+   }
+
+   // Reverse the cities from x to y, in the segment's own direction.
+   unsigned int x = reversed[s] ? b : a, y = reversed[s] ? a : b;
+   bool x_first = x == first[s], y_last = y == last[s];
+   unsigned int left = city_prev[x], right = city_next[y];
+
+   part.clear();
+   for (unsigned int c = x; ; c = city_next[c])
+   {
+    part.push_back(c);
+    if (c == y)
+    {
+     break;
+    }
+   }
+
+   int r = rank[x];
+   for (unsigned int i = part.size(); i -- > 0; )
+   {
+    unsigned int c = part[i];
+    rank[c] = r ++;
+    city_next[c] = i > 0 ? part[i - 1] : c;
+    city_prev[c] = i + 1 < part.size() ? part[i + 1] : c;
+   }
+
+   // Connect the reversed cities to the rest of the segment.
+   if (x_first)
+   {
+    first[s] = y;
+   }
+   else
+   {
+    city_next[left] = y;
+    city_prev[y] = left;
+   }
+   if (y_last)
+   {
+    last[s] = x;
+   }
+   else
+   {
+    city_prev[right] = x;
+    city_next[x] = right;
+   }
+  }
+
+  // Move the cities of segment s from its head to c (if to_prev is true) to the end of the previous segment, or from c to its tail (otherwise) to the beginning of the next segment.
+  // The rest of segment s must not be empty.
+  void split(const unsigned int &s, const unsigned int &c, const bool &to_prev)
+  {
+   const unsigned int t = to_prev ? segment_prev[s] : segment_next[s];
+
+   // Collect the cities to move in the tour's direction, and take them out of s.
+   part.clear();
+   for (unsigned int x = to_prev ? head(s) : c; ; x = next(x))
+   {
+    part.push_back(x);
+    if (x == (to_prev ? c : tail(s)))
+    {
+     break;
+    }
+   }
+   if (to_prev != reversed[s]) // The cities were at the beginning of s, in its own direction.
+   {
+    first[s] = city_next[to_prev ? part.back() : part.front()];
+   }
+   else
+   {
+    last[s] = city_prev[to_prev ? part.back() : part.front()];
+   }
+   count[s] -= part.size();
+
+   // Put them into t, after its tail or before its head in the tour's direction.
+   if (to_prev)
+   {
+    for (unsigned int i = 0; i < part.size(); i ++)
+    {
+     unsigned int x = part[i];
+     if (reversed[t])
+     {
+      city_next[x] = first[t];
+      city_prev[first[t]] = x;
+      first[t] = x;
+     }
+     else
+     {
+      city_prev[x] = last[t];
+      city_next[last[t]] = x;
+      last[t] = x;
+     }
+    }
+   }
+   else
+   {
+    for (unsigned int i = part.size(); i -- > 0; )
+    {
+     unsigned int x = part[i];
+     if (reversed[t])
+     {
+      city_prev[x] = last[t];
+      city_next[last[t]] = x;
+      last[t] = x;
+     }
+     else
+     {
+      city_next[x] = first[t];
+      city_prev[first[t]] = x;
+      first[t] = x;
+     }
+    }
+   }
+   count[t] += part.size();
+   unbalanced = unbalanced || count[t] > 4 * group;
+
+   renumber(s);
+   renumber(t);
+  }
+
+  // Make city c the first city of its segment (if at_head is true) or the last, by moving the smaller part of its segment to a neighboring segment.
+  void makeEnd(const unsigned int &c, const bool &at_head)
+  {
+   const unsigned int s = parent[c];
+   if (c == (at_head ? head(s) : tail(s)))
+   {
+    return;
+   }
+
+   // This is the number of cities that come before the cut, which is before c if at_head is true, and after c otherwise.
+   unsigned int n_before = position(c) - position(head(s)) + (at_head ? 0 : 1);
+   if (2 * n_before <= count[s])
+   {
+    split(s, at_head ? prev(c) : c, true);
+   }
+   else
+   {
+    split(s, at_head ? c : next(c), false);
+   }
+  }
+
+  // Reverse the segments from s to t, going forward.
+  void reverseSegments(const unsigned int s, const unsigned int t) // These are copies, since they may be read from the links that we change.
+  {
+   const unsigned int p = segment_prev[s], n = segment_next[t];
+   const int n_segments = segment_next.size();
+   int r = segment_rank[s];
+
+   run.clear();
+   for (unsigned int x = s; ; x = segment_next[x])
+   {
+    run.push_back(x);
+    if (x == t)
+    {
+     break;
+    }
+   }
+
+   for (unsigned int i = run.size(); i -- > 0; )
+   {
+    unsigned int x = run[i];
+    reversed[x] = !reversed[x];
+    segment_rank[x] = r;
+    r = r + 1 == n_segments ? 0 : r + 1;
+    segment_next[x] = i > 0 ? run[i - 1] : n;
+    segment_prev[x] = i + 1 < run.size() ? run[i + 1] : p;
+   }
+   segment_next[p] = t;
+   segment_prev[n] = s;
+  }
+  // Reverse the path going forward from city a to city b, or the rest of the tour (see reverse).
+  void reversePath(const unsigned int &a, const unsigned int &b)
+  {
+   if (a == b)
+   {
+    return;
+   }
+
+   // A path within one segment is reversed there; if the path goes around the whole tour instead, we reverse the rest of the tour, which lies within the segment.
+   if (parent[a] == parent[b])
+   {
+    if (before(a, b))
+    {
+     reverseWithin(parent[a], a, b);
+    }
+    else if (next(b) != a)
+    {
+     reverseWithin(parent[a], next(b), prev(a));
+    }
+    return;
+   }
+
+   // Make a the head of its segment; this may move a into the segment of b, or the rest of a's segment into it.
+   makeEnd(a, true);
+   if (parent[a] == parent[b])
+   {
+    reversePath(a, b);
+    return;
+   }
+
+   // Make b the tail of its segment, unless the rest of b's segment would then be moved in front of a.
+   // In that case, the rest of the tour lies between b and a within b's segment, and we reverse it instead.
+   if (b != tail(parent[b]) && segment_next[parent[b]] == parent[a] && 2 * static_cast<unsigned int>(position(b) - position(head(parent[b])) + 1) > count[parent[b]])
+   {
+    reverseWithin(parent[b], next(b), tail(parent[b]));
+    return;
+   }
+   makeEnd(b, false);
+   if (parent[a] == parent[b])
+   {
+    reversePath(a, b);
+    return;
+   }
+
+   // Now, the path consists of the whole segments from a's to b's; reverse them, or the rest of the segments, whichever are fewer.
+   const unsigned int n_segments = segment_next.size();
+   const unsigned int s = parent[a], t = parent[b];
+   const unsigned int length = (segment_rank[t] - segment_rank[s] + n_segments) % n_segments + 1;
+   if (2 * length <= n_segments)
+   {
+    reverseSegments(s, t);
+   }
+   else if (length < n_segments)
+   {
+    reverseSegments(segment_next[t], segment_prev[s]);
+   }
+  }
+ public:
+
+  TwoLevelList() : group(1), start(0), unbalanced(false)
+  {
+  }
+
+  template <class Itinerary>
+  explicit TwoLevelList(const Itinerary &tour) : TwoLevelList()
+  {
+   load(tour);
+  }
+
+  // Record the order of the cities in tour.
+  template <class Itinerary>
+  void load(const Itinerary &tour)
+  {
+   const unsigned int n = tour.size();
+
+   city_next.resize(n);
+   city_prev.resize(n);
+   parent.resize(n);
+   rank.resize(n);
+   group = max(8u, static_cast<unsigned int>(sqrt(static_cast<double>(n))));
+   start = tour[0];
+
+   // Link the cities as one reversed-free segment, so that next works while cutting it up.
+   segment_next.assign(1, 0);
+   segment_prev.assign(1, 0);
+   reversed.assign(1, false);
+   first.assign(1, tour[0]);
+   last.assign(1, tour.back());
+   for (unsigned int i = 0; i < n; i ++)
+   {
+    city_next[tour[i]] = tour[i + 1 < n ? i + 1 : i];
+    city_prev[tour[i]] = tour[i > 0 ? i - 1 : i];
+    parent[tour[i]] = 0;
+   }
+   cut(start);
+  }
+
+  // Write the order of the cities into tour, beginning with the city with which the loaded itinerary began.
+  // The length of tour is left alone.
+  template <class Index>
+  void store(BasicTourView<Index> tour) const
+  {
+   unsigned int c = start;
+   for (unsigned int i = 0; i < city_next.size(); i ++)
+   {
+    tour[i] = c;
+    c = next(c);
+   }
+  }
+
+  unsigned int size() const
+  {
+   return city_next.size();
+  }
+
+  // Return the city after c.
+  unsigned int next(const unsigned int &c) const
+  {
+   const unsigned int s = parent[c];
+   if (c == tail(s))
+   {
+    return head(segment_next[s]);
+   }
+   return reversed[s] ? city_prev[c] : city_next[c];
+  }
+
+  // Return the city before c.
+  unsigned int prev(const unsigned int &c) const
+  {
+   const unsigned int s = parent[c];
+   if (c == head(s))
+   {
+    return tail(segment_prev[s]);
+   }
+   return reversed[s] ? city_next[c] : city_prev[c];
+  }
+
+  // Return whether b is met on the way forward from a to c (counting a and c).
+  bool between(const unsigned int &a, const unsigned int &b, const unsigned int &c) const
+  {
+   // Compare the cities by the ranks of their segments, and then by their positions within them.
+   auto key = [&](const unsigned int &x) { return make_pair(segment_rank[parent[x]], position(x)); };
+   pair<int, int> i = key(a), j = key(b), k = key(c);
+   return i <= k ? i <= j && j <= k : i <= j || j <= k;
+  }
+
+  // Reverse the path going forward from city a to city b (or, which gives the same closed path, the rest of the tour).
+  void reverse(const unsigned int &a, const unsigned int &b)
+  {
+   reversePath(a, b);
+
+   // Moving cities between segments may let some of them grow large; if so, cut the tour up again.
+   if (unbalanced)
+   {
+    cut(start);
+    unbalanced = false;
+   }
+  }
+
+  // Replace the edges (a, b) and (c, d) with (a, c) and (b, d), where b follows a and d follows c in the same direction around the tour (see TourOrder::move).
+  void move(const unsigned int &a, const unsigned int &b, const unsigned int &c, const unsigned int &d)
+  {
+   if (next(a) == b)
+   {
+    reverse(b, c);
+   }
+   else
+   {
+    reverse(c, b);
+   }
+   (void)d; // The edge (c, d) is determined by c and the direction.
+  }
+};
+
+// A queue of active cities, for local search with don't-look bits.
+// A city is active if some improving move might start from it; at first all cities are, and after each improving move, the cities at the ends of the changed edges become active again.
+// Each city is in the queue at most once, so the queue never needs more than one slot per city.
+class ActiveQueue {
+ private:
+  vector<unsigned int> cities; // This is a circular buffer.
+  vector<bool> queued;
+  unsigned int head;
+  unsigned int count;
+ public:
+
+  ActiveQueue() : head(0), count(0)
+  {
+  }
+
+  // Make every city of the tour active, in tour order.
+  template <class Itinerary>
+  void fill(const Itinerary &tour)
+  {
+   cities.assign(tour.begin(), tour.end());
+   queued.assign(tour.size(), true);
+   head = 0;
+   count = tour.size();
+  }
+
+  bool empty() const
+  {
+   return count == 0;
+  }
+
+  // Make city c active, unless it already is.
+  void push(const unsigned int &c)
+  {
+   if (!queued[c])
+   {
+    queued[c] = true;
+    cities[(head + count) % cities.size()] = c;
+    count ++;
+   }
+  }
+
+  unsigned int pop()
+  {
+   unsigned int c = cities[head];
+   head = (head + 1) % cities.size();
+   count --;
+   queued[c] = false;
+   return c;
+  }
+};
+
+// 2-opt removes two edges of a tour and reconnects the two resulting paths the other way, which reverses one of them.
+// We only try moves in which a city is joined to one of its candidates, and we try the candidates nearest first, stopping as soon as the new edge is no shorter than the edge it replaces (no improving move can follow, as Lin and Kernighan observed).
+// The gain of a move is computed from the four edges involved, in constant time.
+// The cities from which no improving move was found are skipped (their don't-look bits are set) until a neighboring edge changes.
+template <class Order, class Metric = EuclideanMetric>
+class BasicTwoOpt {
+ private:
+  typedef BasicMap<Metric> Map;
+
+  const Map &map;
+  const CandidateGraph &candidates;
+  Order order;
+  ActiveQueue active;
+
+  // Try to find an improving move that removes an edge at a, and make the first one found.
+  // Return the gain, or 0 if there was no improving move.
+  double improveCity(const unsigned int &a)
+  {
+   for (unsigned int direction = 0; direction < 2; direction ++)
+   {
+    // Going forward, we remove the edges (a, a_next) and (c, c_next), and add (a, c) and (a_next, c_next); going backward, the same with the cities before a and c.
+    unsigned int a_next = direction == 0 ? order.next(a) : order.prev(a);
+    double removed = map.distance(a, a_next);
+
+    for (const unsigned int *candidate = candidates.begin(a); candidate != candidates.end(a); candidate ++)
+    {
+     unsigned int c = *candidate;
+     double g = removed - map.distance(a, c);
+     if (g <= 0) // The candidates are sorted by distance, so no later candidate will do better.
+     {
+      break;
+     }
+
+     unsigned int c_next = direction == 0 ? order.next(c) : order.prev(c);
+     double gain = g + map.distance(c, c_next) - map.distance(a_next, c_next);
+     if (gain > 1e-9)
+     {
+      order.move(a, a_next, c, c_next);
+      active.push(a);
+      active.push(a_next);
+      active.push(c);
+      active.push(c_next);
+      return gain;
+     }
+    }
+   }
+   return 0;
+  }
+ public:
+
+  // Create a 2-opt optimizer for tours of map, using the indicated candidates.
+  // The map must outlive the optimizer.
+  explicit BasicTwoOpt(const Map &m, const CandidateSet &set = DELAUNAY_AND_NEAREST_CANDIDATES) : map(m), candidates(m.candidates(set))
+  {
+  }
+
+  // Apply improving 2-opt moves to tour until there are none, and return the total decrease in length.
+  // The tour keeps its first city, and its length is kept up to date.
+  template <class Index>
+  double optimize(BasicTourView<Index> tour)
+  {
+   double gain = 0;
+
+   if (tour.size() < 4) // There are no 2-opt moves.
+   {
+    return 0;
+   }
+
+   order.load(tour);
+   active.fill(tour);
+   while (!active.empty())
+   {
+    gain += improveCity(active.pop()); // If there is no improving move, the city simply stays out of the queue.
+   }
+
+   if (gain > 0)
+   {
+    order.store(tour);
+    tour.changeLength(-gain, map);
+   }
+   return gain;
+  }
+
+  template <class Index>
+  double optimize(BasicTour<Index> &tour)
+  {
+   return optimize(tour.view());
+  }
+};
+
+typedef BasicTwoOpt<TourOrder> TwoOpt;
+
+// Or-opt moves a segment of one to three consecutive cities to somewhere else in the tour, possibly reversing it.
+// (Random rotation in mutate moves segments blindly; here, we only try the places next to a candidate of one end of the segment.)
+// Removing the segment from between p and n and putting it between c and d changes three edges, so the gain of a move is computed in constant time.
+// Like 2-opt, the search starts from active cities only, and candidates are tried nearest first.
+template <class Order, class Metric = EuclideanMetric>
+class BasicOrOpt {
+ private:
+  typedef BasicMap<Metric> Map;
+
+  const Map &map;
+  const CandidateGraph &candidates;
+  Order order;
+  ActiveQueue active;
+
+  static const unsigned int max_segment = 3;
+
+  // Return the city after c going forward if direction is 0, or going backward otherwise.
+  unsigned int step(const unsigned int &c, const unsigned int &direction) const
+  {
+   return direction == 0 ? order.next(c) : order.prev(c);
+  }
+
+  // Try to find an improving move of a segment that ends at a, and make the first one found.
+  // Return the gain, or 0 if there was no improving move.
+  double improveCity(const unsigned int &a)
+  {
+   for (unsigned int direction = 0; direction < 2; direction ++)
+   {
+    // The segment runs from a to b in this direction, between p and n.
+    unsigned int p = step(a, 1 - direction);
+    unsigned int b = a;
+    for (unsigned int length = 1; length <= max_segment && length + 3 <= order.size(); length ++)
+    {
+     if (length > 1)
+     {
+      b = step(b, direction);
+     }
+     unsigned int n = step(b, direction);
+     double removed = map.distance(p, a) + map.distance(b, n) - map.distance(p, n); // This is the gain of taking the segment out.
+
+     for (const unsigned int *candidate = candidates.begin(a); candidate != candidates.end(a); candidate ++)
+     {
+      unsigned int c = *candidate;
+      if (removed - map.distance(a, c) <= 0) // The candidates are sorted by distance, so no later candidate will do better.
+      {
+       break;
+      }
+
+      // Skip the cities of the segment.
+      bool inside = false;
+      for (unsigned int x = a; ; x = step(x, direction))
+      {
+       inside = inside || x == c;
+       if (x == b)
+       {
+        break;
+       }
+      }
+      if (inside)
+      {
+       continue;
+      }
+
+      // Put the segment between c and the city d after it, keeping its direction (a next to c), or between the city e before c and c, reversing it (a still next to c).
+      unsigned int d = step(c, direction);
+      unsigned int e = step(c, 1 - direction);
+      if (c != p && removed - map.distance(c, a) - map.distance(b, d) + map.distance(c, d) > 1e-9)
+      {
+       double gain = removed - map.distance(c, a) - map.distance(b, d) + map.distance(c, d);
+       relocate(p, a, b, n, c, d, false);
+       return gain;
+      }
+      if (c != n && removed - map.distance(e, b) - map.distance(a, c) + map.distance(e, c) > 1e-9)
+      {
+       double gain = removed - map.distance(e, b) - map.distance(a, c) + map.distance(e, c);
+       relocate(p, a, b, n, e, c, true);
+       return gain;
+      }
+     }
+    }
+   }
+   return 0;
+  }
+
+  // Move the segment from a to b, which lies between p and n, to between c and d, which follow it in the same direction, and reverse it if reversed is true.
+  // This takes two 2-opt moves, and a third to turn the segment back around.
+  void relocate(const unsigned int &p, const unsigned int &a, const unsigned int &b, const unsigned int &n, const unsigned int &c, const unsigned int &d, const bool &reversed)
+  {
+   order.move(p, a, c, d); // This leaves p c ... n b ... a d.
+   order.move(p, c, n, b); // This leaves p n ... c b ... a d.
+   if (!reversed && a != b)
+   {
+    order.move(c, b, a, d); // This leaves p n ... c a ... b d.
+   }
+
+   active.push(p);
+   active.push(n);
+   active.push(a);
+   active.push(b);
+   active.push(c);
+   active.push(d);
+
+   return;
+  }
+ public:
+
+  // Create an Or-opt optimizer for tours of map, using the indicated candidates.
+  // The map must outlive the optimizer.
+  explicit BasicOrOpt(const Map &m, const CandidateSet &set = DELAUNAY_AND_NEAREST_CANDIDATES) : map(m), candidates(m.candidates(set))
+  {
+  }
+
+  // Apply improving Or-opt moves to tour until there are none, and return the total decrease in length.
+  // The tour keeps its first city, and its length is kept up to date.
+  template <class Index>
+  double optimize(BasicTourView<Index> tour)
+  {
+   double gain = 0;
+
+   if (tour.size() < 4) // There is nowhere to move a segment.
+   {
+    return 0;
+   }
+
+   order.load(tour);
+   active.fill(tour);
+   while (!active.empty())
+   {
+    gain += improveCity(active.pop());
+   }
+
+   if (gain > 0)
+   {
+    order.store(tour);
+    tour.changeLength(-gain, map);
+   }
+   return gain;
+  }
+
+  template <class Index>
+  double optimize(BasicTour<Index> &tour)
+  {
+   return optimize(tour.view());
+  }
+};
+
+typedef BasicOrOpt<TourOrder> OrOpt;
+
+// Lin-Kernighan search makes moves of variable depth: it removes an edge, and then repeatedly adds an edge from the loose end to a candidate and removes one of the candidate's edges, as long as the gain so far is positive.
+// After each step, closing the tour up gives a sequential move; after two steps, it is a 3-opt move, after four steps, a 5-opt move, and so on.
+// We take the best closed tour along the way, so a chain may pass through worse tours to reach a much better one, which neither 2-opt nor Or-opt can do.
+// Each step is made as a 2-opt move (as Johnson and McGeoch describe), so it can be undone; the first steps try several alternatives (backtracking), and the deeper steps only try the most promising one.
+// Iterated, with random double-bridge kicks, this is also a solver in its own right (see solve).
+template <class Order, class Metric = EuclideanMetric>
+class BasicLinKernighan {
+ private:
+  typedef BasicMap<Metric> Map;
+
+  const Map &map;
+  const CandidateGraph &candidates;
+  Order order;
+  ActiveQueue active;
+  unsigned int max_depth; // This is the largest number of steps in a chain.
+
+  // A 2-opt move that replaced the edges (a, b) and (c, d) with (a, c) and (b, d); the log lets us undo moves, most recent first.
+  struct Flip {
+   unsigned int a, b, c, d;
+  };
+  vector<Flip> flips;
+
+  vector<pair<unsigned int, unsigned int> > added; // These are the edges added by the current chain, which it may not remove again.
+
+  // This is how many alternatives are tried at each step.
+  static unsigned int breadth(const unsigned int &level)
+  {
+   return level == 0 ? 5 : level == 1 ? 3 : 1;
+  }
+
+  void flip(const unsigned int &a, const unsigned int &b, const unsigned int &c, const unsigned int &d)
+  {
+   order.move(a, b, c, d);
+   flips.push_back({ a, b, c, d });
+  }
+
+  // Undo the moves in the log until only n are left.
+  void undo(const size_t &n)
+  {
+   while (flips.size() > n)
+   {
+    const Flip &f = flips.back();
+    order.move(f.a, f.c, f.b, f.d); // After the move, c follows a and d follows b.
+    flips.pop_back();
+   }
+  }
+
+  bool isAdded(const unsigned int &x, const unsigned int &y) const
+  {
+   for (unsigned int i = 0; i < added.size(); i ++)
+   {
+    if ((added[i].first == x && added[i].second == y) || (added[i].first == y && added[i].second == x))
+    {
+     return true;
+    }
+   }
+   return false;
+  }
+
+  // Extend a chain that has removed the edge (t1, t2), so far with gain g (not counting the edge that would close the tour).
+  // If the chain can be extended to a closed tour that gains more than best, leave the tour changed and return the gain; otherwise, leave the tour as it was and return 0.
+  double extend(const unsigned int &t1, const unsigned int &t2, const double &g, const unsigned int &level, const double &best)
+  {
+   static const unsigned int max_breadth = 5;
+   unsigned int t3s[max_breadth], t4s[max_breadth];
+   double values[max_breadth];
+   unsigned int n = 0;
+   const bool forward = order.next(t2) == t1; // The step goes around the tour in the direction from t2 to t1.
+
+   // Choose the alternatives that keep the most of the gain, i.e., that maximize d(t3, t4) - d(t2, t3).
+   for (const unsigned int *candidate = candidates.begin(t2); candidate != candidates.end(t2); candidate ++)
+   {
+    unsigned int t3 = *candidate;
+    if (g - map.distance(t2, t3) <= 0) // The candidates are sorted by distance, so no later candidate will do better.
+    {
+     break;
+    }
+    if (t3 == order.next(t2) || t3 == order.prev(t2)) // The edge (t2, t3) is already in the tour.
+    {
+     continue;
+    }
+
+    unsigned int t4 = forward ? order.next(t3) : order.prev(t3);
+    if (isAdded(t3, t4))
+    {
+     continue;
+    }
+
+    // Keep the best breadth(level) alternatives, best first.
+    double value = map.distance(t3, t4) - map.distance(t2, t3);
+    if (n < breadth(level) || value > values[n - 1])
+    {
+     unsigned int i = n < breadth(level) ? n ++ : n - 1;
+     for (; i > 0 && values[i - 1] < value; i --)
+     {
+      t3s[i] = t3s[i - 1];
+      t4s[i] = t4s[i - 1];
+      values[i] = values[i - 1];
+     }
+     t3s[i] = t3;
+     t4s[i] = t4;
+     values[i] = value;
+    }
+   }
+
+   for (unsigned int i = 0; i < n; i ++)
+   {
+    unsigned int t3 = t3s[i], t4 = t4s[i];
+    size_t n_flips = flips.size();
+
+    // Add (t2, t3) and remove (t3, t4); the move also adds (t4, t1), which closes the tour, and which the next step removes.
+    flip(t2, t1, t3, t4);
+    added.push_back(make_pair(t2, t3));
+    double g_open = g + values[i];
+    double closed = g_open - map.distance(t4, t1);
+
+    double deeper = level + 1 < max_depth ? extend(t1, t4, g_open, level + 1, max(best, closed)) : 0;
+    added.pop_back();
+    if (deeper > 0)
+    {
+     return deeper;
+    }
+    if (closed > best + 1e-9)
+    {
+     return closed;
+    }
+    undo(n_flips);
+   }
+   return 0;
+  }
+
+  // Try to find an improving chain that starts by removing an edge at t1, and make it.
+  // Return the gain, or 0 if there was no improving chain.
+  double improveCity(const unsigned int &t1)
+  {
+   for (unsigned int direction = 0; direction < 2; direction ++)
+   {
+    unsigned int t2 = direction == 0 ? order.next(t1) : order.prev(t1);
+    size_t n_flips = flips.size();
+    double gain = extend(t1, t2, map.distance(t1, t2), 0, 0);
+    if (gain > 0)
+    {
+     for (size_t i = n_flips; i < flips.size(); i ++)
+     {
+      active.push(flips[i].a);
+      active.push(flips[i].b);
+      active.push(flips[i].c);
+      active.push(flips[i].d);
+     }
+     return gain;
+    }
+   }
+   return 0;
+  }
+
+  // Improve the loaded tour from the active cities until there are none, and return the gain.
+  // The log of moves is kept if keep_log is true, so that the search can be undone.
+  double search(const bool &keep_log)
+  {
+   double gain = 0;
+   while (!active.empty())
+   {
+    gain += improveCity(active.pop());
+    if (!keep_log)
+    {
+     flips.clear();
+    }
+   }
+   return gain;
+  }
+
+  // Make a random double-bridge move, which cuts the tour into segments A B C D and puts them back together as A C B D, with short segments B and C.
+  // No sequential move can undo it, so it lets the search escape from a local optimum.
+  // Return the gain (which is usually negative).
+  double kick(Random &random)
+  {
+   const unsigned int n = order.size();
+   const unsigned int longest = max(1u, min(50u, (n - 2) / 2)); // B and C together leave at least two cities for D and A.
+
+   unsigned int a1 = random.index(0, n);
+   unsigned int b0 = order.next(a1), b1 = b0;
+   for (unsigned int k = random.index(1, longest + 1); k > 1; k --)
+   {
+    b1 = order.next(b1);
+   }
+   unsigned int c0 = order.next(b1), c1 = c0;
+   for (unsigned int k = random.index(1, longest + 1); k > 1; k --)
+   {
+    c1 = order.next(c1);
+   }
+   unsigned int d0 = order.next(c1);
+
+   double gain = map.distance(a1, b0) + map.distance(b1, c0) + map.distance(c1, d0) - map.distance(a1, c0) - map.distance(c1, b0) - map.distance(b1, d0);
+   flip(a1, b0, c1, d0); // This leaves A C' B' D, where ' means reversed.
+   flip(a1, c1, c0, b1); // This leaves A C B' D.
+   flip(c1, b1, b0, d0); // This leaves A C B D.
+
+   active.push(a1);
+   active.push(b0);
+   active.push(b1);
+   active.push(c0);
+   active.push(c1);
+   active.push(d0);
+
+   return gain;
+  }
+ public:
+
+  // Create a Lin-Kernighan optimizer for tours of map, using the indicated candidates, with chains of at most depth steps.
+  // The map must outlive the optimizer.
+  explicit BasicLinKernighan(const Map &m, const CandidateSet &set = DELAUNAY_AND_NEAREST_CANDIDATES, const unsigned int &depth = 50) : map(m), candidates(m.candidates(set)), max_depth(depth)
+  {
+  }
+
+  // Apply improving chains to tour until there are none, and return the total decrease in length.
+  // The tour keeps its first city, and its length is kept up to date.
+  template <class Index>
+  double optimize(BasicTourView<Index> tour)
+  {
+   double gain = 0;
+
+   if (tour.size() < 5) // Every tour is optimal.
+   {
+    return 0;
+   }
+
+   order.load(tour);
+   active.fill(tour);
+   gain = search(false);
+
+   if (gain > 0)
+   {
+    order.store(tour);
+    tour.changeLength(-gain, map);
+   }
+   return gain;
+  }
+
+  template <class Index>
+  double optimize(BasicTour<Index> &tour)
+  {
+   return optimize(tour.view());
+  }
+
+  // Optimize tour, and then n_kicks times, kick it and optimize it again, keeping the result only if it is shorter (this is iterated Lin-Kernighan).
+  // Return the total decrease in length.
+  template <class Index>
+  double solve(BasicTourView<Index> tour, const unsigned int &n_kicks, Random &random)
+  {
+   double gain = 0;
+
+   if (tour.size() < 8) // There is no room for a kick.
+   {
+    return optimize(tour);
+   }
+
+   order.load(tour);
+   active.fill(tour);
+   gain = search(false);
+
+   for (unsigned int k = 0; k < n_kicks; k ++)
+   {
+    flips.clear();
+    double change = kick(random);
+    change += search(true);
+    if (change > 1e-9)
+    {
+     gain += change;
+    }
+    else
+    {
+     undo(0);
+    }
+   }
+   flips.clear();
+
+   if (gain > 0)
+   {
+    order.store(tour);
+    tour.changeLength(-gain, map);
+   }
+   return gain;
+  }
+
+  template <class Index>
+  double solve(BasicTour<Index> &tour, const unsigned int &n_kicks, Random &random)
+  {
+   return solve(tour.view(), n_kicks, random);
+  }
+};
+
+typedef BasicLinKernighan<TourOrder> LinKernighan;
+
+// The kinds of local search that can improve the children in the genetic algorithm.
+enum LocalSearch {
+ NO_LOCAL_SEARCH,
+ TWO_OPT_SEARCH,
+ OR_OPT_SEARCH,
+ TWO_AND_OR_OPT_SEARCH, // 2-opt and Or-opt in turn, until neither improves the tour.
+ LIN_KERNIGHAN_SEARCH
+};
+
+// An alias table lets us draw an index in [0, n) with given probabilities in constant time (this is Walker's alias method, built as described by Vose).
+// We pick a column uniformly at random, and then we keep it or take its alias according to the column's threshold.
+class AliasTable {
+ private:
+  vector<double> threshold; // The probability with which we keep column k...
+  vector<unsigned int> alias; // ... and the index we return otherwise.
+
+  vector<unsigned int> small, large; // These are scratch space for build, kept so that rebuilding doesn't allocate.
+ public:
+
+  // Build the table for probabilities proportional to weights, which should be nonnegative and not all zero.
+  void build(const vector<double> &weights)
+  {
+   const unsigned int n = weights.size();
+   double total = 0;
+   unsigned int k;
+
+   for (k = 0; k < n; k ++)
+   {
+    total += weights[k];
+   }
+
+   threshold.resize(n);
+   alias.resize(n);
+   small.clear();
+   large.clear();
+
+   // Scale the weights so that their average is 1, and sort the columns into those that are under-full and those that are over-full.
+   for (k = 0; k < n; k ++)
+   {
+    threshold[k] = weights[k] * n / total;
+    alias[k] = k;
+    if (threshold[k] < 1)
+    {
+     small.push_back(k);
+    }
+    else
+    {
+     large.push_back(k);
+    }
+   }
+
+   // Fill each under-full column with the excess of an over-full column.
+   while (!small.empty() && !large.empty())
+   {
+    unsigned int s = small.back();
+    unsigned int l = large.back();
+    small.pop_back();
+    alias[s] = l;
+    threshold[l] -= 1 - threshold[s];
+    if (threshold[l] < 1)
+    {
+     large.pop_back();
+     small.push_back(l);
+    }
+   }
+
+   // Whatever is left is full, up to rounding errors.
+   for (k = 0; k < small.size(); k ++)
+   {
+    threshold[small[k]] = 1;
+   }
+   for (k = 0; k < large.size(); k ++)
+   {
+    threshold[large[k]] = 1;
+   }
+
+   return;
+  }
+
+  // Draw a random index according to the probabilities with which the table was built.
+  unsigned int sample(Random &random) const
+  {
+   unsigned int k = random.index(0, threshold.size());
+   return random.real(0, 1) < threshold[k] ? k : alias[k];
+  }
+};
+
+// The ways in which a population can choose parents.
+enum SelectionMethod {
+ TOURNAMENT_SELECTION, // Draw depth tours at random, and take the fittest of them.
+ RANK_SELECTION, // Rank the tours, and choose rank r with a probability that decreases linearly in r.
+ FITNESS_PROPORTIONAL_SELECTION, // Choose each tour with a probability proportional to its fitness, i.e., 1 / length.
+ TRUNCATION_SELECTION // Choose uniformly among a fixed fraction of the fittest tours.
+};
+
+// A selector chooses parents from a population of tours.
+// It only ever returns indices, so the population itself is never reordered, and references to tours remain valid.
+// Call prepare once per generation, before calling select; then every call to select takes constant time (or time proportional to depth, for a tournament).
+class Selector {
+ private:
+  SelectionMethod _method;
+  double _pressure; // For rank selection, the best tour is chosen _pressure times as often as the average tour; it should be in [1, 2].
+  double _truncation; // For truncation selection, this is the fraction of the tours that can become parents; it should be in (0, 1].
+
+  vector<unsigned int> order; // The indices of the tours, with the fittest tours first (as far as the method requires).
+  unsigned int n_candidates; // Truncation selection chooses among order[0], ..., order[n_candidates - 1].
+  vector<double> weights;
+  AliasTable table;
+ public:
+
+  explicit Selector(const SelectionMethod &method = TOURNAMENT_SELECTION, const double &pressure = 1.5, const double &truncation = 0.2) : _method(method), _pressure(pressure), _truncation(truncation), n_candidates(0)
+  {
+  }
+
+  const SelectionMethod &method() const
+  {
+   return _method;
+  }
+
+  // Get ready to choose parents from the tours whose lengths are given.
+  // This must be called again whenever the tours change.
+  void prepare(const vector<double> &lengths)
+  {
+   const unsigned int n = lengths.size();
+   unsigned int k;
+
+   // Rank and truncation selection both need the indices of the tours in order of fitness.
+   if (_method == RANK_SELECTION || _method == TRUNCATION_SELECTION)
+   {
+    order.resize(n);
+    for (k = 0; k < n; k ++)
+    {
+     order[k] = k;
+    }
+   }
+
+   switch (_method)
+   {
+    case TOURNAMENT_SELECTION: // A tournament needs no preparation.
+    break;
+    case RANK_SELECTION:
+     sort(order.begin(), order.end(), [&](const unsigned int &x, const unsigned int &y) { return lengths[x] < lengths[y]; });
+     weights.resize(n);
+     for (k = 0; k < n; k ++)
+     {
+      weights[k] = n > 1 ? _pressure - (2 * _pressure - 2) * k / (n - 1) : 1; // The weight of rank k, where rank 0 is the fittest.
+     }
+     table.build(weights);
+    break;
+    case FITNESS_PROPORTIONAL_SELECTION:
+     weights.resize(n);
+     for (k = 0; k < n; k ++)
+     {
+      weights[k] = 1 / lengths[k];
+     }
+     table.build(weights);
+    break;
+    case TRUNCATION_SELECTION:
+     // We only need to know which tours are the fittest, not the order among the rest.
+     n_candidates = max(1u, min(n, static_cast<unsigned int>(_truncation * n)));
+     partial_sort(order.begin(), order.begin() + n_candidates, order.end(), [&](const unsigned int &x, const unsigned int &y) { return lengths[x] < lengths[y]; });
+    break;
+   }
+
+   return;
+  }
+
+  // Return the index of a parent among the tours whose lengths are given (and were given to prepare).
+  // For a tournament, depth is the number of tours competing; it should be a positive integer.
+  // The choice is made with random.
+  unsigned int select(const vector<double> &lengths, const unsigned int &depth, Random &random) const
+  {
+   unsigned int best, k;
+
+   switch (_method)
+   {
+    case TOURNAMENT_SELECTION:
+     best = random.index(0, lengths.size());
+     for (k = 1; k < depth; k ++)
+     {
+      unsigned int other = random.index(0, lengths.size());
+      if (lengths[other] < lengths[best])
+      {
+       best = other;
+      }
+     }
+     return best;
+    case RANK_SELECTION:
+     return order[table.sample(random)];
+    case FITNESS_PROPORTIONAL_SELECTION:
+     return table.sample(random);
+    case TRUNCATION_SELECTION:
+     return order[random.index(0, n_candidates)];
+   }
+
+   return 0;
+  }
+};
+
+// The ways in which a population can evolve.
+enum Evolution {
+ PANMICTIC_EVOLUTION, // Any two tours can mate; parents are chosen from the whole population by a Selector.
+ SYNCHRONOUS_CELLULAR_EVOLUTION, // The tours live on a grid, and each mates only with its neighbors; every cell is updated from the previous generation at once.
+ ASYNCHRONOUS_CELLULAR_EVOLUTION // The same, except that the cells are updated one after another, in place, so a cell already sees the updates of the cells before it.
+};
+
+// The neighbors of a cell in a grid.
+enum Neighborhood {
+ VON_NEUMANN_NEIGHBORHOOD, // The four cells that share an edge with it.
+ MOORE_NEIGHBORHOOD // The eight cells that share an edge or a corner with it.
+};
+
+// The class Population consists of a map and a population of tours based on the map.
+// It also handles evolution, the basis of the genetic algorithm.
+// The map measures distances with Metric, and the tours number its cities with Index (see BasicTour).
+// A Population uses the exact Euclidean distance, and chooses Index by the size of the map (see BasicAdaptivePopulation).
+template <class Metric, class Index = unsigned int>
+class BasicPopulation {
+ private:
+  typedef BasicMap<Metric> Map;
+  typedef BasicConstTourView<Index> ConstTourView;
+  typedef BasicTourView<Index> TourView;
+  typedef BasicTour<Index> Tour;
+  typedef BasicTourArena<Index> TourArena;
+  typedef BasicTwoOpt<TourOrder, Metric> TwoOpt;
+  typedef BasicOrOpt<TourOrder, Metric> OrOpt;
+  typedef BasicLinKernighan<TourOrder, Metric> LinKernighan;
+
+  Random random; // Everything random about this population comes from this generator, or from its substreams.
+  unsigned long long n_generations; // This is the number of generations evolved so far, which numbers the random streams of the next generation.
+
+  shared_ptr<const Map> shared_map; // Several populations (e.g., the islands of an archipelago) can share one map.
+  const Map &map;
+
+  TourArena tours; // The population of individual tours, stored together in one block of memory.
+  // These will be evolved in the course of the genetic algorithm.
+
+  TourArena children; // This is where evolve builds the next generation, before swapping it with tours.
+
+  ThreadPool pool; // Its threads make the children of each generation.
+
+  vector<vector<bool> > visited; // Sex uses visited[w] to remember which cities a child made by thread w already visits.
+
+  Selector selector; // This chooses parents.
+
+  Evolution evolution;
+  Neighborhood neighborhood;
+
+  // For cellular evolution, tour k lives in row k / grid_columns and column k % grid_columns of a grid, whose opposite edges are glued together (i.e., a torus).
+  unsigned int grid_rows;
+  unsigned int grid_columns;
+
+  // For cellular evolution, the grid is cut into square tiles, which are the tasks that the threads of the pool share.
+  // For asynchronous evolution, the tiles are updated in phases, such that no two tiles of the same phase touch each other; tiles_by_phase[f] lists the tiles of phase f.
+  static const unsigned int tile_size = 4;
+  unsigned int tile_columns;
+  vector<vector<unsigned int> > tiles_by_phase;
+
+  vector<Tour> scratch; // Asynchronous evolution makes a child of thread w in scratch[w], before deciding whether to keep it.
+
+  // After mutation, each child is improved by local search with probability p_local_search.
+  LocalSearch local_search;
+  double p_local_search;
+  vector<TwoOpt> two_opt; // Thread w searches with two_opt[w]...
+  vector<OrOpt> or_opt; // ... and or_opt[w]...
+  vector<LinKernighan> lin_kernighan; // ... and lin_kernighan[w].
+
+  unsigned int refresh_interval; // Every this many generations, the lengths of all tours are measured again from scratch (never, if this is 0).
+
+  // Choose a tour at random from tours, and return it.
+  // Depth should be a positive integer; with tournament selection, it is the number of tours competing.
+  // (Of course, there are many ways to choose a good parent; see the class Selector.)
+  // The tours are never reordered, so the returned view stays valid until the next generation replaces them.
+  // The choice is made with the generator random.
+  ConstTourView findParent(const unsigned int &depth, Random &random) const
+  {
+   return tours[selector.select(tours.lengths(), depth, random)];
+  }
+
+  // Make the map of n_cities cities, of the indicated width and height, for the population with the indicated seed.
+  // The map's cities come from a stream of their own, apart from the population's stream.
+  static shared_ptr<const Map> makeMap(const unsigned int &width, const unsigned int &height, const unsigned int &n_cities, const uint64_t &seed, const DistanceStorage &storage, const DistancePrecision &precision, const CityOrder &order)
+  {
+   Random random(seed, 1);
+   return make_shared<Map>(width, height, n_cities, random, storage, precision, 10, 1, order);
+  }
+
+ public:
+
+  // Construct a population, consisting of n_tours tours, based on a map, consisting of n_cities cities, of the indicated width and height.
+  // Everything random about the population, from its map to its evolution, is determined by seed.
+  // The map records its distance table according to storage and precision, and numbers its cities in the given order.
+  // Both generations of tours are allocated here, once and for all.
+  // The population evolves using n_threads threads, or one thread per core if n_threads is 0.
+  BasicPopulation(const unsigned int &width, const unsigned int &height, const unsigned int &n_cities, const unsigned int &n_tours, const uint64_t &seed, const DistanceStorage &storage = FULL_MATRIX, const DistancePrecision &precision = DOUBLE_PRECISION, const unsigned int &n_threads = 0, const CityOrder &order = GENERATION_ORDER) : BasicPopulation(makeMap(width, height, n_cities, seed, storage, precision, order), n_tours, Random(seed), n_threads)
+  {
+  }
+
+  // Construct a population, consisting of n_tours random tours, based on m, which may be shared with other populations.
+  // Everything random about the population comes from r.
+  BasicPopulation(const shared_ptr<const Map> &m, const unsigned int &n_tours, const Random &r, const unsigned int &n_threads = 0) : random(r), n_generations(0), shared_map(m), map(*m), tours(n_tours, m->size()), children(n_tours, m->size()), pool(n_threads), visited(pool.size(), vector<bool>(m->size())), evolution(PANMICTIC_EVOLUTION), neighborhood(VON_NEUMANN_NEIGHBORHOOD), scratch(pool.size()), local_search(NO_LOCAL_SEARCH), p_local_search(0), refresh_interval(0)
+  {
+   unsigned int k;
+
+   // Fill the population with random individual tours.
+   for (k = 0; k < n_tours; k ++)
+   {
+    tours[k].assign(Tour(map, random)); // Add a random tour.
+   }
+
+   // Lay the tours out on the grid with as many rows as possible, up to the number of columns.
+   grid_rows = 1;
+   for (k = 1; k * k <= n_tours; k ++)
+   {
+    if (n_tours % k == 0)
+    {
+     grid_rows = k;
+    }
+   }
+   grid_columns = n_tours / grid_rows;
+
+   // Color the tiles so that tiles of the same color never touch, even across the glued edges of the grid.
+   // Alternating colors 0 and 1 along a row (or column) of tiles works, except that with an odd number of tiles, the last tile touches the first one; that tile gets color 2.
+   unsigned int tile_rows = (grid_rows + tile_size - 1) / tile_size;
+   tile_columns = (grid_columns + tile_size - 1) / tile_size;
+   tiles_by_phase.resize(9);
+   for (k = 0; k < tile_rows * tile_columns; k ++)
+   {
+    unsigned int r = k / tile_columns, c = k % tile_columns;
+    unsigned int row_color = (tile_rows % 2 == 1 && tile_rows > 1 && r == tile_rows - 1) ? 2 : r % 2;
+    unsigned int column_color = (tile_columns % 2 == 1 && tile_columns > 1 && c == tile_columns - 1) ? 2 : c % 2;
+    tiles_by_phase[3 * row_color + column_color].push_back(k);
+   }
+
+   for (k = 0; k < scratch.size(); k ++)
+   {
+    scratch[k].resize(map.size());
+   }
+  }
+
+  // Choose how parents are selected from now on.
+  // (This only matters for panmictic evolution.)
+  void setSelector(const Selector &s)
+  {
+   selector = s;
+  }
+
+  // Choose how the population evolves from now on, and, for cellular evolution, which cells are neighbors.
+  void setEvolution(const Evolution &e, const Neighborhood &n = VON_NEUMANN_NEIGHBORHOOD)
+  {
+   evolution = e;
+   neighborhood = n;
+  }
+
+  // Choose which local search improves the children from now on, and the probability that a child is improved.
+  // The optimizers (one per thread) are made here, so that evolving still allocates no memory.
+  void setLocalSearch(const LocalSearch &l, const double &p = 1)
+  {
+   local_search = l;
+   p_local_search = p;
+   if ((local_search == TWO_OPT_SEARCH || local_search == TWO_AND_OR_OPT_SEARCH) && two_opt.empty())
+   {
+    for (unsigned int w = 0; w < pool.size(); w ++)
+    {
+     two_opt.emplace_back(map);
+    }
+   }
+   if ((local_search == OR_OPT_SEARCH || local_search == TWO_AND_OR_OPT_SEARCH) && or_opt.empty())
+   {
+    for (unsigned int w = 0; w < pool.size(); w ++)
+    {
+     or_opt.emplace_back(map);
+    }
+   }
+   if (local_search == LIN_KERNIGHAN_SEARCH && lin_kernighan.empty())
+   {
+    for (unsigned int w = 0; w < pool.size(); w ++)
+    {
+     lin_kernighan.emplace_back(map);
+    }
+   }
+  }
+
+  // Choose how often the lengths of all tours are measured again from scratch (see refreshLengths); 0 means never.
+  void setRefreshInterval(const unsigned int &n)
+  {
+   refresh_interval = n;
+  }
+
+  // Measure the lengths of all tours from scratch.
+  // Evolution mostly updates lengths edge by edge, so rounding errors could slowly pile up in a tour that survives for many generations.
+  void refreshLengths()
+  {
+   tours.measure(map);
+  }
+
+  // Return the shortest tour.
+  // We only need to look at the lengths for this.
+  ConstTourView fittest() const
+  {
+   const vector<double> &lengths = tours.lengths();
+   return tours[min_element(lengths.begin(), lengths.end()) - lengths.begin()];
+  }
+
+  // Return the length of the shortest tour.
+  double fittestLength() const
+  {
+   const vector<double> &lengths = tours.lengths();
+   return *min_element(lengths.begin(), lengths.end());
+  }
+
+  // Return the number of tours.
+  unsigned int size() const
+  {
+   return tours.size();
+  }
+
+  ConstTourView tour(const unsigned int &k) const
+  {
+   return tours[k];
+  }
+
+  // Put the indices of the n fittest tours, fittest first, in indices.
+  void fittestTours(const unsigned int &n, vector<unsigned int> &indices) const
+  {
+   const vector<double> &lengths = tours.lengths();
+   indices.resize(lengths.size());
+   for (unsigned int k = 0; k < indices.size(); k ++)
+   {
+    indices[k] = k;
+   }
+   partial_sort(indices.begin(), indices.begin() + n, indices.end(), [&](const unsigned int &x, const unsigned int &y) { return lengths[x] < lengths[y]; });
+   indices.resize(n);
+  }
+
+  // Replace the least fit tour with a copy of migrant, which must be based on the same map.
+  void immigrate(const ConstTourView &migrant)
+  {
+   const vector<double> &lengths = tours.lengths();
+   tours[max_element(lengths.begin(), lengths.end()) - lengths.begin()].assign(migrant);
+  }
+
+  // This is the heart of the genetic algorithm.
+  // Depth is only used by panmictic evolution (see findParent).
+  void evolve(const double &p_mutate, const unsigned int &depth)
+  {
+   if (evolution == PANMICTIC_EVOLUTION)
+   {
+    evolvePanmictic(p_mutate, depth);
+   }
+   else
+   {
+    evolveCellular(p_mutate);
+   }
+   n_generations ++;
+
+   if (refresh_interval > 0 && n_generations % refresh_interval == 0)
+   {
+    refreshLengths();
+   }
+
+   return;
+  }
+
+  // Return the map on which our population is based.
+  const Map &getMap() const
+  {
+   return map;
+  }
+ private:
+
+  // In panmictic evolution, every tour of the next generation except the best tour we've found is the child of two parents chosen from the whole population.
+  // The children are made in parallel: the threads of the pool share them out in small batches, stealing batches from each other when they run out.
+  // Each child is made with its own random stream, numbered by the generation and the child's index, so the result does not depend on which thread makes which child.
+  void evolvePanmictic(const double &p_mutate, const unsigned int &depth)
+  {
+   // The new generation is written over the tours in children, which already have room for every city, so evolving allocates no memory at all.
+   const unsigned int n_children = children.size();
+   const unsigned int batch = max(1u, n_children / (8 * pool.size())); // This is the number of children in each task, small enough for stealing to balance the load.
+
+   children[0].assign(fittest()); // Keep the best tour that we've already found; it is never mutated.
+
+   selector.prepare(tours.lengths()); // Get ready to choose parents from this generation.
+
+   const Random generation = random.stream(n_generations); // The streams of this generation's children are substreams of this one.
+
+   // Make the children in [1 + k * batch, 1 + (k + 1) * batch), as thread w.
+   auto makeChildren = [&](const unsigned int &k, const unsigned int &w)
+   {
+    unsigned int last = min(n_children, 1 + (k + 1) * batch);
+    for (unsigned int i = 1 + k * batch; i < last; i ++)
+    {
+     Random child_random = generation.stream(i);
+
+     // Let two tours have sex and make a baby tour.
+     ConstTourView a = findParent(depth, child_random); // Mother!
+     ConstTourView b = findParent(depth, child_random); // Father!
+     if (a != b) // If the tours are different, let them have sex.
+     {
+      sex(a, b, map, children[i], visited[w]); // Add the child tour they conceived.
+     }
+     else // The tours are identical, so even if they have sex, the resulting child will be the same as a, which is the same as b.
+     {
+      children[i].assign(a); // Everybody's the same...
+     }
+
+     // Randomly perform a mutation in order to ensure genetic diversity.
+     children[i].mutate(p_mutate, map, child_random);
+
+     improve(children[i], w, child_random);
+    }
+   };
+   pool.run((n_children - 1 + batch - 1) / batch, makeChildren);
+   // Now, we have made a new generation of baby tours.
+
+   tours.swap(children); // Replace the old generation with the new generation; the old generation's memory will hold the next one.
+
+   return;
+  }
+
+  // Maybe improve child by local search, as thread w.
+  // The generator random is only used if there is a local search to do, so turning it off gives the same results as before it existed.
+  void improve(TourView child, const unsigned int &w, Random &random)
+  {
+   if (local_search == NO_LOCAL_SEARCH || random.real() >= p_local_search)
+   {
+    return;
+   }
+
+   switch (local_search)
+   {
+    case TWO_OPT_SEARCH:
+     two_opt[w].optimize(child);
+     break;
+    case OR_OPT_SEARCH:
+     or_opt[w].optimize(child);
+     break;
+    case TWO_AND_OR_OPT_SEARCH:
+     do {
+      two_opt[w].optimize(child);
+     } while (or_opt[w].optimize(child) > 0);
+     break;
+    case LIN_KERNIGHAN_SEARCH:
+     lin_kernighan[w].optimize(child);
+     break;
+    default:
+     break;
+   }
+
+   return;
+  }
+
+  // Return the index of the cell that is dr rows and dc columns away from cell k, where dr and dc are in {-1, 0, 1}.
+  unsigned int neighbor(const unsigned int &k, const int &dr, const int &dc) const
+  {
+   unsigned int r = (k / grid_columns + grid_rows + dr) % grid_rows;
+   unsigned int c = (k % grid_columns + grid_columns + dc) % grid_columns;
+   return r * grid_columns + c;
+  }
+
+  // Make the child of cell k in child, as thread w: the tour in cell k mates with the fitter of two of its neighbors chosen at random, and the child is mutated (and maybe improved).
+  // The parents are read from grid.
+  void makeCellChild(const TourArena &grid, const unsigned int &k, TourView child, const unsigned int &w, const double &p_mutate, Random &random)
+  {
+   static const int offsets[8][2] = { { -1, 0 }, { 1, 0 }, { 0, -1 }, { 0, 1 }, { -1, -1 }, { -1, 1 }, { 1, -1 }, { 1, 1 } }; // The first four are the von Neumann neighbors.
+   const unsigned int n_neighbors = neighborhood == VON_NEUMANN_NEIGHBORHOOD ? 4 : 8;
+
+   const int *x = offsets[random.index(0, n_neighbors)];
+   const int *y = offsets[random.index(0, n_neighbors)];
+   unsigned int i = neighbor(k, x[0], x[1]);
+   unsigned int j = neighbor(k, y[0], y[1]);
+
+   ConstTourView a = grid[k]; // Mother!
+   ConstTourView b = grid[grid.lengths()[j] < grid.lengths()[i] ? j : i]; // Father!
+   if (a != b)
+   {
+    sex(a, b, map, child, visited[w]);
+   }
+   else
+   {
+    child.assign(a);
+   }
+
+   child.mutate(p_mutate, map, random);
+
+   improve(child, w, random);
+
+   return;
+  }
+
+  // Update the cells of tile t, as thread w.
+  // If in_place is true, the cells of tours are updated one after another, so later cells see the children of earlier cells; otherwise, the children are made from tours, and kept in children.
+  // Either way, a cell only takes its child if the child is no longer than the tour already there, so the best tour is never lost.
+  void updateTile(const unsigned int &t, const unsigned int &w, const bool &in_place, const double &p_mutate, const Random &generation)
+  {
+   unsigned int r0 = (t / tile_columns) * tile_size, c0 = (t % tile_columns) * tile_size;
+   unsigned int r1 = min(grid_rows, r0 + tile_size), c1 = min(grid_columns, c0 + tile_size);
+
+   for (unsigned int r = r0; r < r1; r ++)
+   {
+    for (unsigned int c = c0; c < c1; c ++)
+    {
+     unsigned int k = r * grid_columns + c;
+     Random cell_random = generation.stream(k);
+
+     if (in_place)
+     {
+      makeCellChild(tours, k, scratch[w].view(), w, p_mutate, cell_random);
+      if (scratch[w].length() <= tours.lengths()[k])
+      {
+       tours[k].assign(scratch[w]);
+      }
+     }
+     else
+     {
+      makeCellChild(tours, k, children[k], w, p_mutate, cell_random);
+      if (children[k].length() > tours.lengths()[k])
+      {
+       children[k].assign(tours[k]);
+      }
+     }
+    }
+   }
+
+   return;
+  }
+
+  // In cellular evolution, each tour mates only with its neighbors on the grid, so good tours spread slowly, and the population stays diverse for much longer.
+  // The tiles of the grid are shared among the threads of the pool.
+  // As with panmictic evolution, each cell's child is made with its own random stream, and the result does not depend on the number of threads.
+  void evolveCellular(const double &p_mutate)
+  {
+   const Random generation = random.stream(n_generations);
+
+   if (evolution == SYNCHRONOUS_CELLULAR_EVOLUTION)
+   {
+    // Every child is made from the previous generation, so all of the tiles can be updated at once.
+    auto update = [&](const unsigned int &t, const unsigned int &w)
+    {
+     updateTile(t, w, false, p_mutate, generation);
+    };
+    pool.run((grid_rows + tile_size - 1) / tile_size * tile_columns, update);
+    tours.swap(children);
+   }
+   else
+   {
+    // Tiles that touch each other must not be updated at the same time, so we update the tiles one phase at a time.
+    // Tiles of the same phase never touch, so the result is the same as if we updated them one after another.
+    for (unsigned int f = 0; f < tiles_by_phase.size(); f ++)
+    {
+     const vector<unsigned int> &tiles = tiles_by_phase[f];
+     auto update = [&](const unsigned int &t, const unsigned int &w)
+     {
+      updateTile(tiles[t], w, true, p_mutate, generation);
+     };
+     pool.run(tiles.size(), update);
+    }
+   }
+
+   return;
+  }
+};
+
+// An adaptive population holds a BasicPopulation whose tours number the cities with uint16_t if the map has at most 65536 cities, and with unsigned int otherwise.
+// It has the interface of BasicPopulation, and it forwards each call to the population that it holds, so the choice is made once per call (e.g., once per generation), and never once per city.
+// The tours that it returns are copies numbered with unsigned int, so that nothing outside depends on the choice.
+template <class Metric>
+class BasicAdaptivePopulation {
+ private:
+  typedef BasicMap<Metric> Map;
+
+  unique_ptr<BasicPopulation<Metric, uint16_t> > narrow; // Exactly one of these holds the population.
+  unique_ptr<BasicPopulation<Metric, unsigned int> > wide;
+ public:
+
+  static const unsigned int max_narrow_cities = 65536;
+
+  // Construct a population as BasicPopulation does.
+  BasicAdaptivePopulation(const unsigned int &width, const unsigned int &height, const unsigned int &n_cities, const unsigned int &n_tours, const uint64_t &seed, const DistanceStorage &storage = FULL_MATRIX, const DistancePrecision &precision = DOUBLE_PRECISION, const unsigned int &n_threads = 0, const CityOrder &order = GENERATION_ORDER)
+  {
+   if (n_cities <= max_narrow_cities)
+   {
+    narrow.reset(new BasicPopulation<Metric, uint16_t>(width, height, n_cities, n_tours, seed, storage, precision, n_threads, order));
+   }
+   else
+   {
+    wide.reset(new BasicPopulation<Metric, unsigned int>(width, height, n_cities, n_tours, seed, storage, precision, n_threads, order));
+   }
+  }
+
+  BasicAdaptivePopulation(const shared_ptr<const Map> &m, const unsigned int &n_tours, const Random &r, const unsigned int &n_threads = 0)
+  {
+   if (m->size() <= max_narrow_cities)
+   {
+    narrow.reset(new BasicPopulation<Metric, uint16_t>(m, n_tours, r, n_threads));
+   }
+   else
+   {
+    wide.reset(new BasicPopulation<Metric, unsigned int>(m, n_tours, r, n_threads));
+   }
+  }
+
+  // Return whether the tours number the cities with uint16_t.
+  bool isNarrow() const
+  {
+   return narrow != nullptr;
+  }
+
+  void setSelector(const Selector &s)
+  {
+   if (narrow)
+   {
+    narrow->setSelector(s);
+   }
+   else
+   {
+    wide->setSelector(s);
+   }
+  }
+
+  void setEvolution(const Evolution &e, const Neighborhood &n = VON_NEUMANN_NEIGHBORHOOD)
+  {
+   if (narrow)
+   {
+    narrow->setEvolution(e, n);
+   }
+   else
+   {
+    wide->setEvolution(e, n);
+   }
+  }
+
+  void setLocalSearch(const LocalSearch &l, const double &p = 1)
+  {
+   if (narrow)
+   {
+    narrow->setLocalSearch(l, p);
+   }
+   else
+   {
+    wide->setLocalSearch(l, p);
+   }
+  }
+
+  void setRefreshInterval(const unsigned int &n)
+  {
+   if (narrow)
+   {
+    narrow->setRefreshInterval(n);
+   }
+   else
+   {
+    wide->setRefreshInterval(n);
+   }
+  }
+
+  void refreshLengths()
+  {
+   if (narrow)
+   {
+    narrow->refreshLengths();
+   }
+   else
+   {
+    wide->refreshLengths();
+   }
+  }
+
+  Tour fittest() const
+  {
+   if (narrow)
+   {
+    return Tour(narrow->fittest());
+   }
+   return Tour(wide->fittest());
+  }
+
+  // Return the length of the shortest tour, without copying the tour (as fittest does).
+  double fittestLength() const
+  {
+   if (narrow)
+   {
+    return narrow->fittestLength();
+   }
+   return wide->fittestLength();
+  }
+
+  unsigned int size() const
+  {
+   if (narrow)
+   {
+    return narrow->size();
+   }
+   return wide->size();
+  }
+
+  Tour tour(const unsigned int &k) const
+  {
+   if (narrow)
+   {
+    return Tour(narrow->tour(k));
+   }
+   return Tour(wide->tour(k));
+  }
+
+  void fittestTours(const unsigned int &n, vector<unsigned int> &indices) const
+  {
+   if (narrow)
+   {
+    narrow->fittestTours(n, indices);
+   }
+   else
+   {
+    wide->fittestTours(n, indices);
+   }
+  }
+
+  void immigrate(const ConstTourView &migrant)
+  {
+   if (narrow)
+   {
+    narrow->immigrate(BasicTour<uint16_t>(migrant));
+   }
+   else
+   {
+    wide->immigrate(migrant);
+   }
+  }
+
+  void evolve(const double &p_mutate, const unsigned int &depth)
+  {
+   if (narrow)
+   {
+    narrow->evolve(p_mutate, depth);
+   }
+   else
+   {
+    wide->evolve(p_mutate, depth);
+   }
+  }
+
+  const Map &getMap() const
+  {
+   if (narrow)
+   {
+    return narrow->getMap();
+   }
+   return wide->getMap();
+  }
+};
+
+typedef BasicAdaptivePopulation<EuclideanMetric> Population;
 
-// For the most part, a map is just a list of cities that should be visited along a tour.
-// To this end, the class Map is derived from the class vector.
-// For convenience, we also record the _width and _height for which all cities belong to [0, _width)x[0, _height).
-class Map : public vector<City> {
+// In the island model, several populations (islands) evolve side by side, each on its own thread, and every so often each island sends copies of its fittest tours (migrants) to its neighbors.
+// The islands keep each other from converging prematurely, since each one explores on its own, while good tours still spread.
+
+// A migrant queue carries tours from one island to another.
+// Exactly one thread pushes and exactly one thread pops, so the queue needs no locks: each side owns one index, and it publishes that index with release semantics after touching the slot.
+// The slots are tours with room for every city, so migrating allocates no memory.
+template <class Index>
+class BasicMigrantQueue {
  private:
-  unsigned int _width;
-  unsigned int _height;
+  vector<BasicTour<Index> > slots;
+  atomic<unsigned long long> head; // This is the number of tours popped so far; only the receiver changes it.
+  char padding[64]; // This keeps head and tail on different cache lines, so that the sender and receiver don't slow each other down.
+  atomic<unsigned long long> tail; // This is the number of tours pushed so far; only the sender changes it.
  public:
 
-  // Create a map of width w and height h, containing n distinct, random cities.
-  // The parameters w, h, and n should all be positive integers.
-  Map(const unsigned int &w, const unsigned int &h, const unsigned int &n) : _width(w), _height(h)
+  // Create a queue that can hold capacity tours of n_cities cities each.
+  BasicMigrantQueue(const unsigned int &capacity, const unsigned int &n_cities) : slots(capacity), head(0), tail(0)
   {
-   // Keep adding random cities until we have n of them.
-   while (size() < n)
+   for (unsigned int k = 0; k < capacity; k ++)
    {
-    City city(_width, _height); // Create a random city.
-    if (find(begin(), end(), city) == end()) // Check whether this random city has already been added.
-    {
-     push_back(city); // If this random city is distinct from those cities already added, then add it.
-    }
+    slots[k].resize(n_cities);
    }
   }
 
-  // The cities on our map are recorded in a vector of cities.
-  // This function returns the Euclidean distance between the city at index i and the city at index j.
-  // The parameters i and j should be in [0, size()).
-  double distance(const unsigned int &i, const unsigned int &j) const
-  {
-   return distanceBetweenCities((*this)[i], (*this)[j]);
-  }
-
-  unsigned int width() const
+  // Copy tour into the queue, and return whether there was room for it.
+  bool push(const BasicConstTourView<Index> &tour)
   {
-   return _width;
+   unsigned long long t = tail.load(memory_order_relaxed);
+   if (t - head.load(memory_order_acquire) == slots.size())
+   {
+    return false;
+   }
+   slots[t % slots.size()].view().assign(tour);
+   tail.store(t + 1, memory_order_release);
+   return true;
   }
 
-  unsigned int height() const
+  // Copy the oldest tour in the queue to tour, remove it from the queue, and return whether there was one.
+  bool pop(BasicTourView<Index> tour)
   {
-   return _height;
+   unsigned long long h = head.load(memory_order_relaxed);
+   if (h == tail.load(memory_order_acquire))
+   {
+    return false;
+   }
+   tour.assign(slots[h % slots.size()]);
+   head.store(h + 1, memory_order_release);
+   return true;
   }
 };
 
-// The parameter itinerary, which in the following function is a vector of unsigned integers, indicates the order in which the cities on our map are to be visited.
-// If N is equal to map.size(), then any itinerary we would like to consider is just a permutation of the N-1 last elements of the ordered set (0, 1, ..., N-1).
-// Return the Euclidean length of the itinerary, beginning and ending at the city map[itinerary[0]].
-double lengthOfItinerary(const vector<unsigned int> &itinerary, const Map &map)
-{
- unsigned int i;
- double length = map.distance(itinerary[0], itinerary.back());
- for (i = 1; i < itinerary.size(); i ++)
- {
-  length += map.distance(itinerary[i - 1], itinerary[i]);
- }
- return length;
-}
+// The ways in which islands can be connected; each island sends migrants along its outgoing connections.
+enum Topology {
+ RING_TOPOLOGY, // Island i sends migrants to island i + 1 (and the last island to the first).
+ TORUS_TOPOLOGY, // The islands form a grid, with opposite edges glued together, and each island sends migrants to the (up to four) islands next to it.
+ COMPLETE_TOPOLOGY // Every island sends migrants to every other island.
+};
 
-// A tour is an itinerary together with the itinerary's Euclidean length.
-// The itinerary will be followed, starting with the city indicated by its first element and finishing at the same city.
-// Hence, the itinerary forms a closed path.
-// Any cyclic permutation of the itinerary determines the same closed path, so we kill this redundancy by requiring all itineraries to have the same first element.
-// The reason we record the length, and not just the itinerary, is that we want to avoid having to compute the length each time we need it.
-class Tour : public vector<unsigned int> {
+// An archipelago is a collection of islands, each a population based on the same map.
+// Migration happens every interval generations: each island sends its n_migrants fittest tours to each neighbor, and then replaces its least fit tours with the migrants it receives.
+// An island waits for its neighbors' migrants of the same round before going on, so a given seed gives the same result every time, however the threads are scheduled.
+// Only neighbors wait for each other, though; there is never a barrier across all of the islands.
+// The islands measure distances with Metric, and number the cities with Index, like the populations they are.
+template <class Metric, class Index = unsigned int>
+class BasicArchipelago {
  private:
-  double _length;
- public:
+  typedef BasicMap<Metric> Map;
+  typedef BasicConstTourView<Index> ConstTourView;
+  typedef BasicTour<Index> Tour;
+  typedef BasicPopulation<Metric, Index> Population;
+  typedef BasicMigrantQueue<Index> MigrantQueue;
+
+  shared_ptr<const Map> map;
+  vector<unique_ptr<Population> > islands;
+  unsigned int interval;
+  unsigned int n_migrants;
 
-  // Create a random tour of the cities in map.
-  explicit Tour(const Map &map)
+  vector<unique_ptr<MigrantQueue> > queues; // There is one queue for each connection.
+  vector<vector<unsigned int> > outgoing; // Island i pushes its migrants to the queues outgoing[i]...
+  vector<vector<unsigned int> > incoming; // ... and pops migrants from the queues incoming[i].
+
+  vector<unsigned long long> n_generations; // This is the number of generations that each island has evolved.
+
+  // Connect island i to island j, unless they are the same or already connected.
+  void connect(const unsigned int &i, const unsigned int &j)
   {
-   // Add the numbers 0, 1, ..., map.size()-1 to the itinerary on which this tour is based.
-   unsigned int i;
-   for (i = 0; i < map.size(); i ++)
+   if (i == j)
    {
-    push_back(i);
+    return;
+   }
+   for (unsigned int k = 0; k < outgoing[i].size(); k ++)
+   {
+    if (find(incoming[j].begin(), incoming[j].end(), outgoing[i][k]) != incoming[j].end())
+    {
+     return;
+    }
    }
 
-   random_shuffle(begin() + 1, end()); // Make the itinerary random by shuffling all but the first element.
-
-   _length = lengthOfItinerary(*this, map); // Record the length of the resulting itinerary.
+   // Each queue holds a few rounds of migrants, which is as far as one island can get ahead of its neighbors.
+   outgoing[i].push_back(queues.size());
+   incoming[j].push_back(queues.size());
+   queues.push_back(unique_ptr<MigrantQueue>(new MigrantQueue(4 * n_migrants, map->size())));
   }
 
-  // Create a tour based on itinerary and map.
-  Tour(const vector<unsigned int> &itinerary, const Map &map)
+  // Send migrants from island i to its neighbors, and receive migrants from them.
+  // The scratch space is that of the thread running island i.
+  void migrate(const unsigned int &i, vector<unsigned int> &indices, Tour &migrant)
   {
-   assign(itinerary.begin(), itinerary.end()); // Record the indicated itinerary.
+   unsigned int k, q;
+   Population &island = *islands[i];
 
-   _length = lengthOfItinerary(*this, map);// Record the length of the itinerary.
-  }
+   island.fittestTours(n_migrants, indices);
+   for (q = 0; q < outgoing[i].size(); q ++)
+   {
+    for (k = 0; k < indices.size(); k ++)
+    {
+     while (!queues[outgoing[i][q]]->push(island.tour(indices[k]))) // The neighbor is behind, so give it a chance to catch up.
+     {
+      this_thread::yield();
+     }
+    }
+   }
 
-  const double &length() const
-  {
-   return _length;
+   for (q = 0; q < incoming[i].size(); q ++)
+   {
+    for (k = 0; k < n_migrants; k ++)
+    {
+     while (!queues[incoming[i][q]]->pop(migrant.view())) // The neighbor hasn't sent this round's migrants yet.
+     {
+      this_thread::yield();
+     }
+     island.immigrate(migrant);
+    }
+   }
+
+   return;
   }
+ public:
 
-  // Consider three kinds of changes (i.e., mutations) to an itinerary that can shorten it.
-  // One way is to swap two cities.
-  // Another way is to reverse the order of a subsequence of cities.
-  // Yet one more way is to apply a cyclic permutation to a subsequence of cities.
-  // The parameter p in [0, 1] indicates the probability with which a mutation occurs.
-  // Since we are dealing with tours, not just itineraries, we want to record the length of the mutated itinerary; this requires that we have the corresponding map as well.
-  // Return the type of mutation that we performed.
-  // (At the moment, nothing in this program actually cares what kind of mutation we performed, but it might be interesting to keep a record of it in a later version of this program.)
-  int mutate(const double &p, const Map &map)
+  // Create n_islands islands of n_tours tours each, based on a map consisting of n_cities cities of the indicated width and height.
+  // The islands are connected according to topology, and n_migrants tours (fewer than n_tours) migrate along each connection every interval generations.
+  // Everything random about the archipelago is determined by seed.
+  // The map records its distance table according to storage and precision, and numbers its cities in the given order.
+  BasicArchipelago(const unsigned int &width, const unsigned int &height, const unsigned int &n_cities, const unsigned int &n_islands, const unsigned int &n_tours, const uint64_t &seed, const Topology &topology = RING_TOPOLOGY, const unsigned int &migration_interval = 10, const unsigned int &migrants = 2, const DistanceStorage &storage = FULL_MATRIX, const DistancePrecision &precision = DOUBLE_PRECISION, const CityOrder &order = GENERATION_ORDER) : interval(max(1u, migration_interval)), n_migrants(migrants), outgoing(n_islands), incoming(n_islands), n_generations(n_islands, 0)
   {
-   // Randomly decide whether to perform a mutation.
-   if (randomDouble(0, 1) > p) // In this case, don't perform a mutation.
+   unsigned int i;
+
+   Random random(seed, 1);
+   map = make_shared<Map>(width, height, n_cities, random, storage, precision, 10, 1, order);
+
+   // Each island runs on one thread, so it does not need a pool of its own.
+   for (i = 0; i < n_islands; i ++)
    {
-    return -1;
+    islands.push_back(unique_ptr<Population>(new Population(map, n_tours, Random(seed).stream(i), 1)));
    }
 
-   int mutation; // The is where we will record the type of mutation performed.
-   // The meaning of the integer mutation is indicated in the switch statement below.
-
-   // Get random indices i and j in [0, size()), with i < j.
-   unsigned int i = randomIndex(1, size() - 1);
-   unsigned int j = randomIndex(i + 1, size());
+   if (n_migrants == 0)
+   {
+    return;
+   }
 
-   // Given any indices i and j as above, we can certainly perform swap and reverse mutations.
-   // However, a rotation requires that there is some index in between i and j.
-   while (true)
+   if (topology == TORUS_TOPOLOGY)
    {
-    mutation = rand() % 3; // Randomly choose a mutation type.
+    // Use the grid with as many rows as possible, up to the number of columns.
+    unsigned int rows = 1, columns;
+    for (unsigned int r = 1; r * r <= n_islands; r ++)
+    {
+     if (n_islands % r == 0)
+     {
+      rows = r;
+     }
+    }
+    columns = n_islands / rows;
 
-    // Try to perform a mutation.
-    switch (mutation)
+    for (i = 0; i < n_islands; i ++)
     {
-     case 0:
-      ::swap((*this)[i], (*this)[j]);
-     break;
-     case 1:
-      reverse(begin() + i, begin() + j + 1);
-     break;
-     case 2:
-      if (j - i > 2) // If there is an index in between i and j, perform a rotation.
-      {
-       rotate(begin() + i, begin() + randomIndex(i + 1, j), begin() + j + 1); // Randomly choose an index in between i and j, and perform the corresponding rotation.
-      }
-      else // In this case, i and j are consecutive, so we can only hope to do a swap or reverse mutation.
+     unsigned int r = i / columns, c = i % columns;
+     connect(i, r * columns + (c + 1) % columns);
+     connect(i, r * columns + (c + columns - 1) % columns);
+     connect(i, ((r + 1) % rows) * columns + c);
+     connect(i, ((r + rows - 1) % rows) * columns + c);
+    }
+   }
+   else
+   {
+    for (i = 0; i < n_islands; i ++)
+    {
+     if (topology == RING_TOPOLOGY)
+     {
+      connect(i, (i + 1) % n_islands);
+     }
+     else
+     {
+      for (unsigned int j = 0; j < n_islands; j ++)
       {
-       continue; // Go back to the beginning: Randomly choose a mutation, and see if we can perform it.
+       connect(i, j);
       }
-     break;
+     }
     }
-
-    // If we reach this point, we have successfully performed a mutation.
-    break; // Don't try to perform any more mutations.
    }
-
-   _length = lengthOfItinerary(*this, map); // Record the length of the mutated itinerary.
-
-   return mutation; // Return the type of mutation.
   }
-};
-
-// Take two tours as parameters, and combine them to make a better tour.
-// The algorithm to construct itinerary from a and b is straightforward:
-/*
- 1) Add the initial city (i.e., the city from which all tours begin and end), to itinerary.
- 2) Find the first cities from a and b that haven't been added to itinerary.
- 3) Among these two cities, add to itinerary the one nearer to the last citi in itinerary.
- 4) Go back to step (2).
-*/
-// Clearly, the resulting itinerary can be no worse than the shorter of a and b.
-// Return the tour based on the itinerary created in the algorithm above.
-// (Call the function sex for fun!)
-// Tours a and b should both be based on map.
-Tour sex(const Tour &a, const Tour &b, const Map &map)
-{
- unsigned int i = 1; // This is the position from which we should begin searching a.
- unsigned int j = 1; // This is the position from which we should begin searching b.
-
- vector<unsigned int> itinerary; // This is the itinerary we want to create.
-
- itinerary.push_back(0); // Set the first city to be the same as the first city of all the itineraries under consideration.
 
- while (itinerary.size() < map.size())
- {
-  // In what follows, a legitimate city is one that does not yet appear in itinerary.
-
-  // Find next legitimate city in a.
-  while (find(itinerary.begin(), itinerary.end(), a[i]) != itinerary.end())
+  // Choose how parents are selected on every island from now on.
+  void setSelector(const Selector &s)
   {
-   i ++;
+   for (unsigned int i = 0; i < islands.size(); i ++)
+   {
+    islands[i]->setSelector(s);
+   }
   }
-  // Now, either i is equal to a.size(), or a[i] is the next legitimate city in a.
 
-  // Do the same thing for b.
-  while (find(itinerary.begin(), itinerary.end(), b[j]) != itinerary.end())
+  // Choose how often every island measures its lengths again (see Population::setRefreshInterval).
+  void setRefreshInterval(const unsigned int &n)
   {
-   j ++;
+   for (unsigned int i = 0; i < islands.size(); i ++)
+   {
+    islands[i]->setRefreshInterval(n);
+   }
   }
 
-  if (i == a.size()) // We've reached the end of a, so the only remaining cities to add are those in b.
+  // Choose the local search of every island (see Population::setLocalSearch).
+  void setLocalSearch(const LocalSearch &l, const double &p = 1)
   {
-   itinerary.push_back(b[j]); // Add the next legitimate city in b.
-   j ++;
+   for (unsigned int i = 0; i < islands.size(); i ++)
+   {
+    islands[i]->setLocalSearch(l, p);
+   }
   }
-  else if (j == b.size()) // We've reached the end of b, so the only remaining cities to add are those in a.
+
+  // Evolve every island for n generations, each on its own thread, with migrations along the way.
+  void evolve(const double &p_mutate, const unsigned int &depth, const unsigned int &n = 1)
   {
-   itinerary.push_back(a[i]); // Add the next legitimate city in a.
-   i ++;
+   vector<thread> threads;
+
+   for (unsigned int i = 0; i < islands.size(); i ++)
+   {
+    threads.push_back(thread([this, i, n, p_mutate, depth]()
+    {
+     vector<unsigned int> indices;
+     Tour migrant;
+     migrant.resize(map->size());
+
+     for (unsigned int g = 0; g < n; g ++)
+     {
+      islands[i]->evolve(p_mutate, depth);
+      if (++ n_generations[i] % interval == 0 && n_migrants > 0)
+      {
+       migrate(i, indices, migrant);
+      }
+     }
+    }));
+   }
+
+   for (unsigned int i = 0; i < threads.size(); i ++)
+   {
+    threads[i].join();
+   }
+
+   return;
   }
-  else // We've reached the end of neither a nor b.
+
+  // Return the shortest tour on any island.
+  ConstTourView fittest() const
   {
-   // Add the next legitimate city from a or b nearest to the last city added to itinerary.
-   if (map.distance(itinerary.back(), a[i]) < map.distance(itinerary.back(), b[j])) // The next legitimate city from a is closer.
+   unsigned int best = 0;
+   for (unsigned int i = 1; i < islands.size(); i ++)
    {
-    itinerary.push_back(a[i]);
-    i ++;
+    if (islands[i]->fittest().length() < islands[best]->fittest().length())
+    {
+     best = i;
+    }
    }
-   else // The next legitimate city from b is no worse than that of a.
+   return islands[best]->fittest();
+  }
+
+  // Return the length of the shortest tour on any island.
+  double fittestLength() const
+  {
+   double length = islands[0]->fittestLength();
+   for (unsigned int i = 1; i < islands.size(); i ++)
    {
-    itinerary.push_back(b[j]);
-    j ++;
+    length = min(length, islands[i]->fittestLength());
    }
+   return length;
   }
 
-  // Repeat this whole process until we reach the end of both a and b.
-  // This is clearly equivalent to itinerary having the same size as a, b, or map (all of which have equal size).
- }
+  unsigned int size() const
+  {
+   return islands.size();
+  }
 
- return Tour(itinerary, map); // Return the tour based on the itinerary we created.
-}
+  const Population &island(const unsigned int &i) const
+  {
+   return *islands[i];
+  }
 
-// We have to define < in order to use max_element.
-bool operator <(const Tour &a, const Tour &b)
-{
- return a.length() > b.length(); // This is equivalent to returning 1 / a.length() < 1 / b.length().
-}
+  // Return the map on which our islands are based.
+  const Map &getMap() const
+  {
+   return *map;
+  }
+};
 
-// The class Population consists of a map and a population of tours based on the map.
-// It also handles evolution, the basis of the genetic algorithm.
-class Population {
+// An adaptive archipelago holds a BasicArchipelago whose islands number the cities with uint16_t if the map has at most 65536 cities, and with unsigned int otherwise, just as an adaptive population does.
+// It forwards each call to the archipelago that it holds; the islands themselves are not exposed, since their type depends on the choice.
+template <class Metric>
+class BasicAdaptiveArchipelago {
  private:
-  Map map;
+  typedef BasicMap<Metric> Map;
 
-  vector<Tour> tours; // The population of individual tours.
-  // These will be evolved in the course of the genetic algorithm.
+  unique_ptr<BasicArchipelago<Metric, uint16_t> > narrow; // Exactly one of these holds the archipelago.
+  unique_ptr<BasicArchipelago<Metric, unsigned int> > wide;
+ public:
 
-  // Choose a tour at random from tours, and return it.
-  // Depth should be a positive integer less than tours.size().
-  // (Of course, there are many ways to choose a good parent...)
-  Tour &findParent(const unsigned int &depth)
+  static const unsigned int max_narrow_cities = 65536;
+
+  // Construct an archipelago as BasicArchipelago does.
+  BasicAdaptiveArchipelago(const unsigned int &width, const unsigned int &height, const unsigned int &n_cities, const unsigned int &n_islands, const unsigned int &n_tours, const uint64_t &seed, const Topology &topology = RING_TOPOLOGY, const unsigned int &migration_interval = 10, const unsigned int &migrants = 2, const DistanceStorage &storage = FULL_MATRIX, const DistancePrecision &precision = DOUBLE_PRECISION, const CityOrder &order = GENERATION_ORDER)
   {
-   random_shuffle(tours.begin(), tours.end());
-   return *max_element(tours.begin(), tours.begin() + depth);
+   if (n_cities <= max_narrow_cities)
+   {
+    narrow.reset(new BasicArchipelago<Metric, uint16_t>(width, height, n_cities, n_islands, n_tours, seed, topology, migration_interval, migrants, storage, precision, order));
+   }
+   else
+   {
+    wide.reset(new BasicArchipelago<Metric, unsigned int>(width, height, n_cities, n_islands, n_tours, seed, topology, migration_interval, migrants, storage, precision, order));
+   }
   }
 
- public:
+  // Return whether the islands number the cities with uint16_t.
+  bool isNarrow() const
+  {
+   return narrow != nullptr;
+  }
 
-  // Construct a population, consisting of n_tours tours, based on a map, consisting of n_cities cities, of the indicated width and height.
-  Population(const unsigned int &width, const unsigned int &height, const unsigned int &n_cities, const unsigned int &n_tours) : map(width, height, n_cities)
+  void setSelector(const Selector &s)
   {
-   // Add random individual tours to the population of tours until we have enough of them.
-   while (tours.size() < n_tours)
+   if (narrow)
    {
-/*
-    // For genetic diversity, add a random tour that is distinct from those already added.
-    // (Of course, the likelihood of duplicating a tour is small...)
-    Tour tour(map);
-    if (find(tours.begin(), tours.end(), tour) == tours.end()) tours.push_back(tour);
-*/
-
-    tours.push_back(Tour(map)); // Add a random tour.
+    narrow->setSelector(s);
+   }
+   else
+   {
+    wide->setSelector(s);
    }
   }
 
-  // Return the shortest tour.
-  const Tour &fittest() const
+  void setRefreshInterval(const unsigned int &n)
   {
-   return *max_element(tours.begin(), tours.end());
+   if (narrow)
+   {
+    narrow->setRefreshInterval(n);
+   }
+   else
+   {
+    wide->setRefreshInterval(n);
+   }
   }
 
-  // This is the heart of the genetic algorithm.
-  void evolve(const double &p_mutate, const unsigned int &depth)
+  void setLocalSearch(const LocalSearch &l, const double &p = 1)
   {
-   vector<Tour> children; // This vector will hold the new generation of tours.
-
-   children.push_back(fittest()); // Keep the best tour that we've already found.
+   if (narrow)
+   {
+    narrow->setLocalSearch(l, p);
+   }
+   else
+   {
+    wide->setLocalSearch(l, p);
+   }
+  }
 
-   // Let the tours have sex and make baby tours until we have enough of them.
-   while (children.size() < tours.size())
+  void evolve(const double &p_mutate, const unsigned int &depth, const unsigned int &n = 1)
+  {
+   if (narrow)
    {
-    Tour &a = findParent(depth); // Mother!
-    Tour &b = findParent(depth); // Father!
-    if (a != b) // If the tours are different, let them have sex.
-    {
-     children.push_back(sex(a, b, map)); // Add the child tour they conceived.
-    }
-    else // The tours are identical, so even if they have sex, the resulting child will be the same as a, which is the same as b.
-    {
-     children.push_back(a); // Everybody's the same...
-    }
+    narrow->evolve(p_mutate, depth, n);
    }
-   // Now, we have made a new generation of baby tours.
+   else
+   {
+    wide->evolve(p_mutate, depth, n);
+   }
+  }
 
-   // Randomly perform mutations in order to ensure genetic diversity, but keep unchanged the best tour we've found until this point.
-   for (unsigned int i = 1; i < children.size(); i ++)
+  Tour fittest() const
+  {
+   if (narrow)
    {
-    children[i].mutate(p_mutate, map);
+    return Tour(narrow->fittest());
    }
+   return Tour(wide->fittest());
+  }
 
-   tours = children; // Replace the old generation with the new generation.
+  double fittestLength() const
+  {
+   if (narrow)
+   {
+    return narrow->fittestLength();
+   }
+   return wide->fittestLength();
+  }
 
-   return;
+  unsigned int size() const
+  {
+   if (narrow)
+   {
+    return narrow->size();
+   }
+   return wide->size();
   }
 
-  // Return the map on which our population is based.
   const Map &getMap() const
   {
-   return map;
+   if (narrow)
+   {
+    return narrow->getMap();
+   }
+   return wide->getMap();
   }
 };
 
+typedef BasicAdaptiveArchipelago<EuclideanMetric> Archipelago;
+
 // This function represents graphically the tour based on the map, by outputting a bitmap image with the indicated file name.
-void tourToBMP(const Tour &tour, const Map &map, const char *file_name)
+template <class Itinerary, class Metric>
+void tourToBMP(const Itinerary &tour, const BasicMap<Metric> &map, const char *file_name)
 {
  unsigned int i;
 
@@ -412,20 +5025,35 @@ void tourToBMP(const Tour &tour, const Map &map, const char *file_name)
 
 int main()
 {
- srand(time(0)); // Seed the random number generator in the standard way.
+ const uint64_t seed = time(0); // This seed determines everything random; to repeat a run exactly, use the seed it printed.
 
  const unsigned int width = 600; // This is the width of our map.
  const unsigned int height = 400; // This is the height of our map.
  const unsigned int n_cities = 30; // This is the total number of cities on our map.
  const unsigned int n_tours = 150; // This is the total number of tours in our population.
 
+ const DistanceStorage storage = FULL_MATRIX; // This is how the map lays out its distance table (NEIGHBOR_CACHE for maps too large for a table).
+ const DistancePrecision precision = DOUBLE_PRECISION; // This is the precision of the entries in the distance table.
+ const CityOrder city_order = GENERATION_ORDER; // This is how the map numbers its cities (HILBERT_ORDER keeps large maps cache friendly).
+
  const unsigned int depth = 10; // This is the depth used for finding a parent.
+ const SelectionMethod selection = TOURNAMENT_SELECTION; // This is how parents are chosen.
+ const Evolution evolution = PANMICTIC_EVOLUTION; // This is how the population evolves.
+ const unsigned int n_threads = 0; // This is the number of threads that make children; 0 means one thread per core.
  const double p_mutate = 0.3; // This is the probability that a mutation occurs.
+ const LocalSearch local_search = NO_LOCAL_SEARCH; // This is how children are improved after mutation (e.g., TWO_OPT_SEARCH, TWO_AND_OR_OPT_SEARCH or LIN_KERNIGHAN_SEARCH).
+ const double p_local_search = 1.0; // This is the probability that a child is improved.
+ const unsigned int refresh_interval = 50; // Every this many generations, the lengths of all tours are measured again from scratch.
 
  const unsigned int n_stop = 100; // This is the stopping condition.
  // If we haven't found a better tour after n_stop generations, then give up looking.
 
- Population population(width, height, n_cities, n_tours);
+ cout << "Seed: " << seed << endl;
+ Population population(width, height, n_cities, n_tours, seed, storage, precision, n_threads, city_order);
+ population.setSelector(Selector(selection));
+ population.setEvolution(evolution);
+ population.setLocalSearch(local_search, p_local_search);
+ population.setRefreshInterval(refresh_interval);
 
  unsigned int n_generations = 0; // This keeps track of which generation the population represents.
  time_t t_total = 0; // This keeps track of the total amount of time (in seconds) spent on the genetic algorithm.
@@ -434,9 +5062,15 @@ int main()
  {
   // Display some information...
   cout << "[Generation #" << n_generations << ']' << endl
-       << "Length: " << population.fittest().length() << endl
-       << "Elapsed time: " << t_total << " seconds" << endl
-       << "Press (enter) to evolve, (b) to draw a picture, or (q) to quit." << endl;
+       << "Length: " << population.fittestLength() << endl
+       << "Elapsed time: " << t_total << " seconds" << endl;
+#ifdef GA_CACHE_STATISTICS
+  if (storage == NEIGHBOR_CACHE)
+  {
+   cout << "Cache hit rate: " << population.getMap().cacheHitRate() << " of " << population.getMap().cacheLookups() << " lookups" << endl;
+  }
+#endif
+  cout << "Press (enter) to evolve, (b) to draw a picture, or (q) to quit." << endl;
 
   char ch = getOneChar(); // Get input.
 
@@ -455,12 +5089,12 @@ int main()
    // Evolve once, and return to the beginning of the loop.
    // (We will check what the user wants to do after each evolution.)
    cout << "Evolving..." << endl;
-   double length = population.fittest().length();
+   double length = population.fittestLength();
    unsigned int i;
    for (i = 1; i <= n_stop; i ++)
    {
     population.evolve(p_mutate, depth);
-    if (population.fittest().length() < length)
+    if (population.fittestLength() < length)
     {
      cout << "The population improved after " << i << " generations." << endl;
      n_generations += i;
@@ -483,7 +5117,7 @@ int main()
 
    // Get ready to evolve.
    cout << "Evolving..." << endl;
-   double length = population.fittest().length();
+   double length = population.fittestLength();
    unsigned int i;
    time_t t_0, t_1;
 
@@ -493,9 +5127,9 @@ int main()
     for (i = 0; i < n_stop; i ++)
     {
      population.evolve(p_mutate, depth);
-     if (population.fittest().length() < length)
+     if (population.fittestLength() < length)
      {
-      length = population.fittest().length();
+      length = population.fittestLength();
       n_generations += i + 1;
       break;
      }